@@ -0,0 +1,104 @@
+#include "bitboard.h"
+
+#include <cstddef>
+
+namespace {
+    // directions 0 - 3 are the orthogonals and 4 - 7 are the diagonals, matching the order of attackTables.rays
+    constexpr std::array towardsHigherSquares = {true, true, false, false, true, false, false, true};
+
+    // magic numbers for the square layout used here (bit 0 = a8), found offline by random search. each one maps every
+    // subset of the square's relevant squares to a distinct index in 2^(relevant square count) slots, or to a shared slot
+    // only when the attack sets are identical
+    constexpr std::array<Bitboard, 64> rookMagicNumbers = {
+        0x0280132180004001ULL, 0x0140001000200040ULL, 0x0880200010000880ULL, 0x2080080005801000ULL,
+        0x0200041020080200ULL, 0x0200041041084200ULL, 0x0400080081124410ULL, 0x2180042100004080ULL,
+        0x8000800099644000ULL, 0x0802003040820100ULL, 0x0105801001862000ULL, 0x0101002008100100ULL,
+        0x1000800400080080ULL, 0x0804800200040080ULL, 0x2001800200800900ULL, 0x00160004088204C1ULL,
+        0x228000C001402000ULL, 0x8510004000200050ULL, 0x3001848020029000ULL, 0x0280808010000801ULL,
+        0x0109010010040800ULL, 0x8000808004000200ULL, 0x8000040081021028ULL, 0x40040A0009004884ULL,
+        0x80C0004280008035ULL, 0x0010004040002000ULL, 0x1101200500410070ULL, 0x8410100080080080ULL,
+        0x000C080080800400ULL, 0x4012008080040002ULL, 0x4000040101000200ULL, 0x0061010200008044ULL,
+        0x0080804010800020ULL, 0x3000201008400040ULL, 0x4112008012002444ULL, 0x0848000880801000ULL,
+        0x00A8008008800400ULL, 0x200200280A00500CULL, 0x080A221024004801ULL, 0xC400008042000104ULL,
+        0x8000400080028022ULL, 0x0220008040018020ULL, 0x4000200011010040ULL, 0x10060040210A0010ULL,
+        0x40820020904A0004ULL, 0x0030040002008080ULL, 0x0200020801840010ULL, 0x0084C04100820004ULL,
+        0x4802010080C2A600ULL, 0x0000400080201880ULL, 0x2040801000200080ULL, 0x0180200842001200ULL,
+        0x0013510008000500ULL, 0x0182000C00808A80ULL, 0x1000524821302400ULL, 0x3800040108488200ULL,
+        0x104A004810210082ULL, 0x0004210010420082ULL, 0xC424110008200241ULL, 0x90101000A0088501ULL,
+        0x0182000420100802ULL, 0x4822001001080402ULL, 0x05D0080090012204ULL, 0x2008140089042846ULL
+    };
+
+    constexpr std::array<Bitboard, 64> bishopMagicNumbers = {
+        0x0420220228022C80ULL, 0x200208010C108000ULL, 0x1004010411040040ULL, 0x12A4040292002440ULL,
+        0x0804042082000850ULL, 0x0802020220010440ULL, 0x800401048260201AULL, 0x0041010800828800ULL,
+        0x4040641488080104ULL, 0x20002004016E0020ULL, 0x0C2C223A12420042ULL, 0x0100024081020220ULL,
+        0x0383211041025080ULL, 0x08C0030420160600ULL, 0x0C1000510808C00AULL, 0x40501A0084140280ULL,
+        0x40280040112C0088ULL, 0x4020040908110050ULL, 0x1028001008801412ULL, 0x0104220202020000ULL,
+        0x800A000400940010ULL, 0x0401000200512410ULL, 0x1082012100900408ULL, 0x0101402208440C00ULL,
+        0x00482104C01C1111ULL, 0x0310105008017101ULL, 0x0022010108080020ULL, 0x02300400104010A0ULL,
+        0x1401010011444000ULL, 0x1001020000405020ULL, 0x00010A0804480411ULL, 0x0419220010404400ULL,
+        0x0010020A00200820ULL, 0xA008280909040104ULL, 0x0210209010080020ULL, 0x3006110800040040ULL,
+        0x0800820200440090ULL, 0x0008100421810080ULL, 0x0028060093264800ULL, 0x0A08004088810080ULL,
+        0x3611100290442000ULL, 0x0241081282001001ULL, 0x11081108010D0800ULL, 0x002A102014420800ULL,
+        0x480002600A004500ULL, 0x8001010102000100ULL, 0x2008080810410883ULL, 0x0002080901101022ULL,
+        0x2800942420444080ULL, 0x2000840108024000ULL, 0x0000804844100040ULL, 0x1444120020884540ULL,
+        0x0004001002020C00ULL, 0x041041C801010049ULL, 0x0060045000850810ULL, 0x1003240C14820208ULL,
+        0x3010104A10100800ULL, 0x0280020101580200ULL, 0x1000000101081600ULL, 0x0644009800420200ULL,
+        0x0050040008102402ULL, 0x00000004601C8106ULL, 0x00088530040812A0ULL, 0x800218010102020CULL
+    };
+
+    // each ray is cut off after the first occupied square along it (which is included, as it can be captured)
+    Bitboard slidingAttacks(const int square, const Bitboard occupied, const int firstDirection, const int lastDirection) {
+        const auto& rays = Bitboards::attackTables.rays;
+        Bitboard attacks = 0;
+        for (auto i = firstDirection; i <= lastDirection; ++i) {
+            attacks |= rays[i][square];
+            if (const auto blockers = rays[i][square] & occupied) {
+                const auto firstBlocker = towardsHigherSquares[i] ? std::countr_zero(blockers) : 63 - std::countl_zero(blockers);
+                attacks &= ~rays[i][firstBlocker];
+            }
+        }
+        return attacks;
+    }
+
+    // the relevant squares are each ray with its last square removed, since a piece on the board edge can't block anything further
+    Bitboard relevantSlidingSquares(const int square, const int firstDirection, const int lastDirection) {
+        const auto& rays = Bitboards::attackTables.rays;
+        Bitboard relevantSquares = 0;
+        for (auto i = firstDirection; i <= lastDirection; ++i) {
+            if (const auto ray = rays[i][square]) {
+                const auto lastSquare = towardsHigherSquares[i] ? 63 - std::countl_zero(ray) : std::countr_zero(ray);
+                relevantSquares |= ray & ~Bitboards::squareBitboard(lastSquare);
+            }
+        }
+        return relevantSquares;
+    }
+
+    void fillSlidingAttackMagics(std::array<Bitboards::SlidingAttackMagic, 64>& magics, const std::array<Bitboard, 64>& magicNumbers, std::vector<Bitboard>& attacks, const int firstDirection, const int lastDirection) {
+        for (auto square = 0; square < 64; ++square) {
+            auto& magic = magics[square];
+            magic.relevantSquares = relevantSlidingSquares(square, firstDirection, lastDirection);
+            magic.magicNumber = magicNumbers[square];
+            magic.shift = 64 - Bitboards::popCount(magic.relevantSquares);
+            magic.offset = static_cast<uint32_t>(attacks.size());
+            attacks.resize(attacks.size() + (size_t{1} << Bitboards::popCount(magic.relevantSquares)));
+
+            // enumerate every subset of the relevant squares (carry-rippler trick) and store its attacks at the index the lookup will compute
+            Bitboard occupied = 0;
+            do {
+                const auto index = Bitboards::slidingAttackIndex(magic, occupied);
+                attacks[magic.offset + index] = slidingAttacks(square, occupied, firstDirection, lastDirection);
+                occupied = (occupied - magic.relevantSquares) & magic.relevantSquares;
+            } while (occupied);
+        }
+    }
+}
+
+Bitboards::SlidingAttackTables Bitboards::generateSlidingAttackTables() {
+    SlidingAttackTables tables;
+    // 102400 rook entries followed by 5248 bishop entries
+    tables.attacks.reserve(107648);
+    fillSlidingAttackMagics(tables.rookMagics, rookMagicNumbers, tables.attacks, 0, 3);
+    fillSlidingAttackMagics(tables.bishopMagics, bishopMagicNumbers, tables.attacks, 4, 7);
+    return tables;
+}
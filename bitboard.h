@@ -0,0 +1,178 @@
+#ifndef CHESS_BITBOARD_H
+#define CHESS_BITBOARD_H
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+// pext is only used when the whole program is compiled for bmi2 (the CHESS_BMI2 cmake option), so the lookup is inlined
+// like the magic one instead of going through a call and a runtime check. msvc has no bmi2 switch of its own, /arch:AVX2 implies it
+#if defined(__BMI2__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define CHESS_USE_PEXT
+#include <immintrin.h>
+#endif
+
+// a bitboard holds one bit per square, so a whole set of squares (all white pawns, every square a knight attacks, etc.)
+// can be tested or combined with a single instruction instead of walking the board square by square.
+// bit index is the same square index the zobrist keys use: rank * 8 + file, where rank 0 is the top of the board
+// (black's back rank) and file 0 is the a-file. so bit 0 is a8 and bit 63 is h1.
+using Bitboard = uint64_t;
+
+namespace Bitboards {
+    inline constexpr Bitboard fileA = 0x0101010101010101ULL;
+    inline constexpr Bitboard fileH = fileA << 7;
+    // ranks are named by their index in the array, not by chess notation (rank 0 is the eighth rank)
+    inline constexpr Bitboard rank0 = 0xFFULL;
+    inline constexpr Bitboard rank1 = rank0 << 8;
+    inline constexpr Bitboard rank6 = rank0 << 48;
+    inline constexpr Bitboard rank7 = rank0 << 56;
+
+    constexpr Bitboard squareBitboard(const int square) {
+        return 1ULL << square;
+    }
+
+    constexpr int popCount(const Bitboard bitboard) {
+        return std::popcount(bitboard);
+    }
+
+    constexpr int leastSignificantSquare(const Bitboard bitboard) {
+        return std::countr_zero(bitboard);
+    }
+
+    // returns the lowest square in the set and removes it, used to iterate over every square in a bitboard
+    constexpr int popLeastSignificantSquare(Bitboard& bitboard) {
+        const int square = std::countr_zero(bitboard);
+        bitboard &= bitboard - 1;
+        return square;
+    }
+
+    // every square attacked by a set of pawns, white pawns (colour 0) attack towards rank 0 and black pawns towards rank 7
+    constexpr Bitboard allPawnAttacks(const Bitboard pawns, const int colour) {
+        if (colour == 0)
+            return ((pawns & ~fileA) >> 9) | ((pawns & ~fileH) >> 7);
+        return ((pawns & ~fileA) << 7) | ((pawns & ~fileH) << 9);
+    }
+
+    struct AttackTables {
+        std::array<Bitboard, 64> knightAttacks{};
+        std::array<Bitboard, 64> kingAttacks{};
+        // pawnAttacks is accessed with [pawn colour][square], 0 = white, 1 = black
+        std::array<std::array<Bitboard, 64>, 2> pawnAttacks{};
+        // every square from the square to the board edge in one direction, accessed with [direction][square].
+        // directions 0 - 3 are the orthogonals and 4 - 7 are the diagonals
+        std::array<std::array<Bitboard, 64>, 8> rays{};
+        // squares strictly between two squares that share a rank, file or diagonal, empty otherwise
+        std::array<std::array<Bitboard, 64>, 64> betweenSquares{};
+        // the full rank, file or diagonal running through two aligned squares (edge to edge), empty otherwise
+        std::array<std::array<Bitboard, 64>, 64> lineThroughSquares{};
+    };
+
+    // built by the compiler, so none of these tables cost anything at startup
+    [[nodiscard]] constexpr AttackTables generateAttackTables() {
+        struct Direction {
+            int fileStep;
+            int rankStep;
+        };
+        constexpr std::array<Direction, 8> slidingDirections = {{{1, 0}, {0, 1}, {-1, 0}, {0, -1}, {1, 1}, {-1, -1}, {1, -1}, {-1, 1}}};
+        constexpr std::array oppositeDirections = {2, 3, 0, 1, 5, 4, 7, 6};
+        constexpr std::array<Direction, 8> knightDirections = {{{2, 1}, {-2, -1}, {2, -1}, {-2, 1}, {1, 2}, {-1, -2}, {1, -2}, {-1, 2}}};
+        const auto isOnBoard = [](const int file, const int rank) {
+            return file >= 0 && file < 8 && rank >= 0 && rank < 8;
+        };
+
+        AttackTables tables;
+        for (auto square = 0; square < 64; ++square) {
+            const auto file = square % 8;
+            const auto rank = square / 8;
+
+            for (const auto& direction : knightDirections) {
+                if (isOnBoard(file + direction.fileStep, rank + direction.rankStep))
+                    tables.knightAttacks[square] |= squareBitboard((rank + direction.rankStep) * 8 + file + direction.fileStep);
+            }
+            for (auto i = 0; i < 8; ++i) {
+                const auto& direction = slidingDirections[i];
+                if (isOnBoard(file + direction.fileStep, rank + direction.rankStep))
+                    tables.kingAttacks[square] |= squareBitboard((rank + direction.rankStep) * 8 + file + direction.fileStep);
+                for (auto step = 1; isOnBoard(file + direction.fileStep * step, rank + direction.rankStep * step); ++step)
+                    tables.rays[i][square] |= squareBitboard((rank + direction.rankStep * step) * 8 + file + direction.fileStep * step);
+            }
+
+            // white pawns move towards rank 0, black pawns towards rank 7
+            for (const auto fileStep : {-1, 1}) {
+                if (isOnBoard(file + fileStep, rank - 1))
+                    tables.pawnAttacks[0][square] |= squareBitboard((rank - 1) * 8 + file + fileStep);
+                if (isOnBoard(file + fileStep, rank + 1))
+                    tables.pawnAttacks[1][square] |= squareBitboard((rank + 1) * 8 + file + fileStep);
+            }
+        }
+
+        // walking out along each ray from the first square, the squares passed so far are the ones between the first square
+        // and the current one, and the ray joined with its opposite direction is the whole line through both of them
+        for (auto first = 0; first < 64; ++first) {
+            for (auto i = 0; i < 8; ++i) {
+                const auto line = tables.rays[i][first] | tables.rays[oppositeDirections[i]][first] | squareBitboard(first);
+                const auto towardsHigherSquares = slidingDirections[i].rankStep * 8 + slidingDirections[i].fileStep > 0;
+                Bitboard between = 0;
+                auto ray = tables.rays[i][first];
+                while (ray) {
+                    // the square nearest the first one is the lowest set bit on rays towards higher squares and the highest on the others
+                    const auto second = towardsHigherSquares ? std::countr_zero(ray) : 63 - std::countl_zero(ray);
+                    ray &= ~squareBitboard(second);
+                    tables.betweenSquares[first][second] = between;
+                    tables.lineThroughSquares[first][second] = line;
+                    between |= squareBitboard(second);
+                }
+            }
+        }
+        return tables;
+    }
+
+    inline constexpr AttackTables attackTables = generateAttackTables();
+
+    // sliding piece attacks are looked up rather than walked ray by ray. only the pieces on a slider's relevant squares
+    // (its rays minus the board edges, which never block anything further) affect its attacks, so every subset of them
+    // is mapped to a unique index into a precomputed table, either by a magic multiply and shift or by bmi2 pext.
+    struct SlidingAttackMagic {
+        Bitboard relevantSquares;
+        Bitboard magicNumber;
+        // index of this square's first entry in the shared attacks table
+        uint32_t offset;
+        uint32_t shift;
+    };
+
+    struct SlidingAttackTables {
+        std::array<SlidingAttackMagic, 64> rookMagics{};
+        std::array<SlidingAttackMagic, 64> bishopMagics{};
+        std::vector<Bitboard> attacks;
+    };
+
+    [[nodiscard]] SlidingAttackTables generateSlidingAttackTables();
+    inline const SlidingAttackTables slidingAttackTables = generateSlidingAttackTables();
+
+    // both indexing schemes give the same table size, so the table is filled in whichever order the build reads it back
+    inline uint64_t slidingAttackIndex(const SlidingAttackMagic& magic, const Bitboard occupied) {
+#ifdef CHESS_USE_PEXT
+        return _pext_u64(occupied, magic.relevantSquares);
+#else
+        return (occupied & magic.relevantSquares) * magic.magicNumber >> magic.shift;
+#endif
+    }
+
+    inline Bitboard lookupSlidingAttacks(const SlidingAttackMagic& magic, const Bitboard occupied) {
+        return slidingAttackTables.attacks[magic.offset + slidingAttackIndex(magic, occupied)];
+    }
+
+    inline Bitboard rookAttacks(const int square, const Bitboard occupied) {
+        return lookupSlidingAttacks(slidingAttackTables.rookMagics[square], occupied);
+    }
+
+    inline Bitboard bishopAttacks(const int square, const Bitboard occupied) {
+        return lookupSlidingAttacks(slidingAttackTables.bishopMagics[square], occupied);
+    }
+
+    inline Bitboard queenAttacks(const int square, const Bitboard occupied) {
+        return rookAttacks(square, occupied) | bishopAttacks(square, occupied);
+    }
+}
+
+#endif //CHESS_BITBOARD_H
@@ -62,16 +62,17 @@ void BoardView::drawBoard(sf::RenderWindow& window) const {
     }
 }
 
-void BoardView::drawPieces(sf::RenderWindow& window, const std::array<std::array<std::optional<Piece>, 8>, 8>& piecePositions, const std::optional<Vector2Int> excludedSquare) const {
+void BoardView::drawPieces(sf::RenderWindow& window, const std::array<Piece::Code, 64>& piecePositions, const std::optional<Vector2Int> excludedSquare) const {
     for (int row = 0; row < 8; ++row) {
         for (int column = 0; column < 8; ++column) {
 
             // check there is a piece on the current square and check the current square is not excluded
-            if (!piecePositions[row][column] || Vector2Int(column, row) == excludedSquare)
+            const auto pieceCode = piecePositions[toSquareIndex(Vector2Int(column, row))];
+            if (pieceCode == Piece::emptySquare || Vector2Int(column, row) == excludedSquare)
                 continue;
 
             // get the texture that matches the piece and use it to initialise a sprite for the piece
-            sf::Sprite sprite(GetPieceTexture(*piecePositions[row][column]));
+            sf::Sprite sprite(GetPieceTexture(Piece::fromCode(pieceCode)));
             sprite.setPosition({column * squareSize,row * squareSize});
             sprite.scale({pieceScale, pieceScale});
             window.draw(sprite);
@@ -102,6 +103,7 @@ void BoardView::drawPawnPromotionPieces(sf::RenderWindow &window, const Piece::C
 }
 
 void BoardView::pickupPieceFromBoard(const Vector2Int startSquare, const std::vector<Vector2Int>& validMovableSquares) {
+    selectedPieceStartSquare = startSquare;
     currentMoveHighlightedSquare = HighlightedSquare(startSquare, HighlightedSquare::HighlightType::STARTMOVE);
     // add the valid movable squares to the list of valid move highlighted squares
     // to avoid solid blocks of colour on the board, sequential valid moves in the horizontal or vertical directions are broken up into two alternating colours
@@ -129,6 +131,7 @@ void BoardView::placePieceOnBoard(const bool pieceMoved, Vector2Int endSquare) {
         previousMoveHighlightedSquares.emplace_back(endSquare, HighlightedSquare::HighlightType::STOPMOVE);
     }
     currentMoveHighlightedSquare = std::nullopt;
+    selectedPieceStartSquare = std::nullopt;
 }
 
 Vector2Int BoardView::getSquare(const int mouseX, const int mouseY) const {
@@ -27,6 +27,8 @@ class BoardView {
         HighlightedSquare(const Vector2Int newPosition, const HighlightType newColourType) : position(newPosition), highlightType(newColourType) {}
     };
 
+    // the square of the piece the player (or engine) is currently moving, kept here rather than in the game state as only the gui needs it
+    std::optional<Vector2Int> selectedPieceStartSquare;
     std::optional<HighlightedSquare> currentMoveHighlightedSquare;
     std::vector<HighlightedSquare> previousMoveHighlightedSquares;
     std::vector<HighlightedSquare> validMoveHighlightedSquares;
@@ -34,12 +36,13 @@ class BoardView {
 public:
     BoardView();
     void drawBoard(sf::RenderWindow& window) const;
-    void drawPieces(sf::RenderWindow& window, const std::array<std::array<std::optional<Piece>, 8>, 8>& piecePositions, std::optional<Vector2Int> excludedSquare) const;
+    void drawPieces(sf::RenderWindow& window, const std::array<Piece::Code, 64>& piecePositions, std::optional<Vector2Int> excludedSquare) const;
     void drawSelectedPiece(sf::RenderWindow& window, Piece piece, int mouseX, int mouseY) const;
     void drawPawnPromotionPieces(sf::RenderWindow& window, Piece::Colour pieceColour, Vector2Int pawnPromotionSquare) const;
     void pickupPieceFromBoard(Vector2Int startSquare, const std::vector<Vector2Int>& validMovableSquares);
     void placePieceOnBoard(bool pieceMoved, Vector2Int endSquare);
     [[nodiscard]] Vector2Int getSquare(int mouseX, int mouseY) const;
+    [[nodiscard]] std::optional<Vector2Int> getSelectedPieceStartSquare() const {return selectedPieceStartSquare;}
 
 private:
     const sf::Texture& GetPieceTexture(Piece piece) const;
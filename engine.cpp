@@ -1,115 +1,468 @@
 #include "engine.h"
 
 #include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <limits>
 #include <random>
 #include <iostream>
 
-void Engine::reset() {
+#if defined(__linux__)
+#include <sys/mman.h>
+#elif defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace {
+    // the size of a large page on x86-64, the table is aligned to it so the os can back the whole table with them
+    constexpr size_t largePageSize = 2 * 1024 * 1024;
+}
 
+void LargePageDeleter::operator()(void* memory) const {
+#if defined(__linux__)
+    if (mapped) {
+        munmap(memory, size);
+        return;
+    }
+#endif
+#if defined(_WIN32)
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+void Engine::reset() {
+    // a new game shares nothing useful with the last one, so its entries are wiped rather than left to age out
+    if (transpositionTable)
+        clearTranspositionTable();
 }
 
 Move Engine::generateEngineMove(const Game& game, const EngineSearchSettings& engineSearchSettings, const std::stop_token& stopToken) {
     // TODO: implement all the engine search settings into the search
-    auto simulatedGame = game;
-    const auto allLegalMoves = game.generateAllLegalMoves(simulatedGame.getCurrentGameState());
+    const auto ttClusters = std::bit_floor(hashMegabytes * 1024 * 1024 / sizeof(TTCluster));
+    if (ttClusterCount != ttClusters) {
+        // the old table is freed first, so resizing never holds both tables at once
+        transpositionTable.reset();
+        transpositionTable = allocateLargePages(ttClusters);
+        ttClusterCount = ttClusters;
+        clearTranspositionTable();
+    }
+    ttGeneration = (ttGeneration + 1) % ttGenerations;
+    if (const auto searchThreadCount = threadCount.value_or(1); searchThreads.size() != searchThreadCount) {
+        searchThreads = std::vector<SearchThread>(searchThreadCount);
+        for (auto& thread : searchThreads) {
+            thread.pawnHashTable.resize(pawnHashSize);
+            thread.materialTable.resize(size_t{1} << materialTableBits);
+        }
+    }
+    MoveList allLegalMoves;
+    game.generateAllLegalMoves(game.getCurrentGameState(), allLegalMoves);
     if (allLegalMoves.empty())
-        return Move({0, 0}, {0, 0});
-
-    // seed bestMove with any legal move so we always have something to return,
-    // even if depth 1 is interrupted before completing
-    bestMove = allLegalMoves.front();
-    Move bestMoveFromLastCompletedIteration = bestMove;
-    positionsEvaluated = 0;
+        return {};
 
     const int maxSearchDepth = engineSearchSettings.depth.value_or(6);
+    // each thread plays its moves on its own copy of the game
+    const auto rootGame = game;
+
+    // the helper threads are stopped as soon as the main thread finishes, as well as whenever the caller asks to stop
+    std::stop_source searchStopSource;
+    const std::stop_callback forwardStopRequest(stopToken, [&searchStopSource] { searchStopSource.request_stop(); });
+    {
+        std::vector<std::jthread> helperThreads;
+        for (size_t i = 1; i < searchThreads.size(); ++i) {
+            helperThreads.emplace_back([&, i] {
+                iterativeDeepening(rootGame, searchThreads[i], i, allLegalMoves.front(), maxSearchDepth, searchStopSource.get_token());
+            });
+        }
+        iterativeDeepening(rootGame, searchThreads[0], 0, allLegalMoves.front(), maxSearchDepth, searchStopSource.get_token());
+        searchStopSource.request_stop();
+    }
+
+    // every thread votes for the best move of its last finished iteration. a vote counts for more the deeper the thread
+    // got and the better it scored the move, and the main thread's move wins any tie
+    const auto minEvaluation = std::ranges::min(searchThreads, {}, &SearchThread::completedEvaluation).completedEvaluation;
+    std::vector<std::pair<Move, int64_t>> votes;
+    for (const auto& thread : searchThreads) {
+        auto vote = std::ranges::find(votes, thread.completedBestMove, &std::pair<Move, int64_t>::first);
+        if (vote == votes.end())
+            vote = votes.insert(vote, {thread.completedBestMove, 0});
+        vote->second += static_cast<int64_t>(thread.completedEvaluation - minEvaluation + 1) * thread.completedDepth;
+    }
+    const auto bestMove = std::ranges::max(votes, std::less{}, &std::pair<Move, int64_t>::second).first;
+
+    auto positionsEvaluated = 0;
+    auto transpositions = 0;
+    for (const auto& thread : searchThreads) {
+        positionsEvaluated += thread.positionsEvaluated;
+        transpositions += thread.transpositions;
+    }
+    std::cout << "total positions evaluated: " << positionsEvaluated << std::endl;
+    std::cout << "total transpositions: " << transpositions << std::endl;
+    return bestMove;
+}
+
+void Engine::iterativeDeepening(const Game& game, SearchThread& thread, const size_t threadIndex, const Move& firstLegalMove, const int maxSearchDepth, const std::stop_token& stopToken) {
+    auto simulatedGame = game;
+    // seed the best move with any legal move so there is always something to return,
+    // even if depth 1 is interrupted before completing
+    thread.bestMove = firstLegalMove;
+    thread.completedBestMove = firstLegalMove;
+    thread.completedEvaluation = 0;
+    thread.completedDepth = 0;
+    thread.positionsEvaluated = 0;
+    thread.transpositions = 0;
+    // killers from the previous search were found at different plies from a different root, so start again
+    thread.killerMoves = {};
 
     // iterative deepening: search progressively deeper, using the best move from the previous
     // iteration as the first move tried in the next iteration. this dramatically improves
     // alpha-beta cutoffs because the previous iteration's best is very likely still best.
     // it also gives anytime behaviour: if stop is requested partway through, we still have
     // a fully-searched best move from the last completed iteration to return.
-    for (int currentDepth = 1; currentDepth <= maxSearchDepth; ++currentDepth) {
+    // every other helper thread starts a ply deeper, so the threads aren't all searching the same depth in step with each other
+    for (int currentDepth = 1 + static_cast<int>(threadIndex % 2); currentDepth <= maxSearchDepth; ++currentDepth) {
         if (stopToken.stop_requested())
             break;
 
-        const int evaluation = search(simulatedGame, minusInfinity, infinity, currentDepth, currentDepth, 0, stopToken);
+        const int evaluation = search(thread, simulatedGame, minusInfinity, infinity, currentDepth, currentDepth, 0, stopToken);
 
-        // if the iteration was cut short, its bestMove update is unreliable; revert to the previous one
-        if (stopToken.stop_requested()) {
-            bestMove = bestMoveFromLastCompletedIteration;
+        // if the iteration was cut short, its best move is unreliable, so the last completed iteration's is kept
+        if (stopToken.stop_requested())
             break;
-        }
 
-        bestMoveFromLastCompletedIteration = bestMove;
-        std::cout << "depth " << currentDepth << " complete, evaluation: " << evaluation << ", positions evaluated so far: " << positionsEvaluated << std::endl;
+        thread.completedBestMove = thread.bestMove;
+        thread.completedEvaluation = evaluation;
+        thread.completedDepth = currentDepth;
+        if (threadIndex == 0) {
+            std::cout << "depth " << currentDepth << " complete, evaluation: " << evaluation << ", positions evaluated so far: " << thread.positionsEvaluated << std::endl;
+            std::cout << "info depth " << currentDepth << " hashfull " << calculateHashfull() << std::endl;
+        }
 
         // forced mate detected — searching deeper cannot improve the outcome
         if (evaluation >= infinity - 1000 || evaluation <= minusInfinity + 1000)
             break;
     }
-
-    std::cout << "total positions evaluated: " << positionsEvaluated << std::endl;
-    std::cout << "total transpositions: " << transpositions << std::endl;
-    return bestMove;
 }
 
-std::vector<std::pair<Move, std::uint64_t>> Engine::generatePerftDivide(const Game& game, const int depth) const {
+std::vector<std::pair<Move, std::uint64_t>> Engine::generatePerftDivide(const Game& game, const int depth) {
+    // the table is only allocated once perft is actually used, and again whenever its size has been changed
+    const auto perftHashEntries = std::bit_floor(perftHashMegabytes * 1024 * 1024 / sizeof(PerftHashEntry));
+    if (perftHashTable.size() != perftHashEntries)
+        perftHashTable = std::vector<PerftHashEntry>(perftHashEntries);
+
     // "divide" output is perft split by root move so external tools can bisect exactly where counts diverge.
-    std::vector<std::pair<Move, std::uint64_t>> divide;
     // use a copy instead of the live session
     auto simulatedGame = game;
     // promotion moves need to be expanded before we start counting, otherwise promotion positions will be undercounted.
-    const auto moves = generatePerftMoves(simulatedGame);
-
-    divide.reserve(moves.size());
-    for (const auto& move : moves) {
-        // play one legal root move, count the subtree below it, then restore the snapshot for the next root move.
-        const auto moveDelta = simulatedGame.movePiece(simulatedGame.getCurrentGameState(), move);
-        const std::uint64_t nodes = perft(simulatedGame, depth - 1);
+    MoveList moves;
+    generatePerftMoves(simulatedGame, moves);
+
+    // every subtree is independent, so the tree is cut into tasks that any thread can pick up. the root moves alone give too
+    // few tasks, of very different sizes, to keep many threads busy, so deeper trees are also split at the second ply
+    struct PerftTask {
+        size_t rootMoveIndex;
+        Move rootMove;
+        // empty when the task is the root move's whole subtree
+        Move secondMove;
+        int depthLeft;
+    };
+    std::vector<PerftTask> tasks;
+    for (size_t i = 0; i < moves.size(); ++i) {
+        if (depth < 4) {
+            tasks.push_back({i, moves[i], {}, depth - 1});
+            continue;
+        }
+        const auto moveDelta = simulatedGame.movePiece(simulatedGame.getCurrentGameState(), moves[i]);
+        MoveList secondMoves;
+        generatePerftMoves(simulatedGame, secondMoves);
         simulatedGame.undoLastMove(simulatedGame.getCurrentGameState(), moveDelta);
-        // keep the original move paired with its subtree size so UCISession can print "move: nodes" lines.
-        divide.emplace_back(move, nodes);
+        for (const auto& secondMove : secondMoves)
+            tasks.push_back({i, moves[i], secondMove, depth - 2});
+    }
+
+    // each thread plays its tasks on its own copy of the game, taking the next unclaimed task whenever it finishes one,
+    // so threads that get small subtrees simply end up doing more of them
+    std::vector<std::uint64_t> taskNodes(tasks.size());
+    std::atomic<size_t> nextTask = 0;
+    const auto perftThreadCount = std::min<size_t>(threadCount.value_or(std::max(1u, std::thread::hardware_concurrency())), tasks.size());
+    {
+        std::vector<std::jthread> workers;
+        for (size_t i = 0; i < perftThreadCount; ++i) {
+            workers.emplace_back([&] {
+                auto workerGame = simulatedGame;
+                auto& gameState = workerGame.getCurrentGameState();
+                for (auto taskIndex = nextTask++; taskIndex < tasks.size(); taskIndex = nextTask++) {
+                    const auto& task = tasks[taskIndex];
+                    const auto rootMoveDelta = workerGame.movePiece(gameState, task.rootMove);
+                    if (task.secondMove != Move()) {
+                        const auto secondMoveDelta = workerGame.movePiece(gameState, task.secondMove);
+                        taskNodes[taskIndex] = perft(workerGame, task.depthLeft);
+                        workerGame.undoLastMove(gameState, secondMoveDelta);
+                    }
+                    else
+                        taskNodes[taskIndex] = perft(workerGame, task.depthLeft);
+                    workerGame.undoLastMove(gameState, rootMoveDelta);
+                }
+            });
+        }
     }
+
+    // keep the original move paired with its subtree size so UCISession can print "move: nodes" lines.
+    std::vector<std::pair<Move, std::uint64_t>> divide;
+    divide.reserve(moves.size());
+    for (const auto& move : moves)
+        divide.emplace_back(move, 0);
+    for (size_t i = 0; i < tasks.size(); ++i)
+        divide[tasks[i].rootMoveIndex].second += taskNodes[i];
     return divide;
 }
 
-int Engine::evaluateBoardPosition(const GameState& gameState) const {
-    int evaluation = countMaterial(gameState, Piece::Colour::WHITE) - countMaterial(gameState, Piece::Colour::BLACK);
+int Engine::evaluateBoardPosition(SearchThread& thread, const GameState& gameState) const {
+    const int perspective = gameState.moveColour == Piece::Colour::WHITE ? 1 : -1;
+    const auto& material = probeMaterial(thread, gameState);
+    // known endings are scored by their own evaluator, unless it can't say anything better than the general evaluation
+    if (material.endgame != MaterialEntry::Endgame::NONE) {
+        if (const auto endgameEvaluation = evaluateEndgame(gameState, material))
+            return *endgameEvaluation * perspective;
+    }
+
+    int evaluation = material.imbalance;
+    evaluation += probePawnStructure(thread, gameState);
 
-    const float endgameWeight = calculateEndgameWeight(gameState);
+    const float endgameWeight = material.endgameWeight;
     const int whiteKingScore = evaluateKingPositionsEndgame(gameState, Piece::Colour::WHITE, endgameWeight);
     const int blackKingScore = evaluateKingPositionsEndgame(gameState, Piece::Colour::BLACK, endgameWeight);
 
     evaluation += whiteKingScore - blackKingScore;
 
-    const int perspective = gameState.moveColour == Piece::Colour::WHITE ? 1 : -1;
     return evaluation * perspective;
 }
 
+const MaterialEntry& Engine::probeMaterial(SearchThread& thread, const GameState& gameState) const {
+    // the packed piece counts are spread over the whole key before taking the top bits, as the low bits only hold white's pawns
+    auto& entry = thread.materialTable[(gameState.materialKey * 0x9E3779B97F4A7C15ULL) >> (64 - materialTableBits)];
+    // a real material key is never 0 (there are always kings), so empty slots never match
+    if (entry.materialKey != gameState.materialKey) {
+        constexpr auto bishopPairBonus = 30;
+        constexpr auto bishop = static_cast<int>(Piece::Type::BISHOP);
+        entry.materialKey = gameState.materialKey;
+        entry.imbalance = countMaterial(gameState, Piece::Colour::WHITE) - countMaterial(gameState, Piece::Colour::BLACK);
+        if (gameState.pieceCounts[0][bishop] >= 2)
+            entry.imbalance += bishopPairBonus;
+        if (gameState.pieceCounts[1][bishop] >= 2)
+            entry.imbalance -= bishopPairBonus;
+        entry.endgameWeight = calculateEndgameWeight(gameState);
+        entry.endgame = classifyEndgame(gameState, entry.strongColour);
+    }
+    return entry;
+}
+
+MaterialEntry::Endgame Engine::classifyEndgame(const GameState& gameState, Piece::Colour& strongColour) {
+    using Endgame = MaterialEntry::Endgame;
+    const auto& counts = gameState.pieceCounts;
+    const auto count = [&counts](const int colour, const Piece::Type type) {
+        return counts[colour][static_cast<int>(type)];
+    };
+    const auto nonKingPieces = [&count](const int colour) {
+        return count(colour, Piece::Type::QUEEN) + count(colour, Piece::Type::ROOK) + count(colour, Piece::Type::BISHOP)
+             + count(colour, Piece::Type::KNIGHT) + count(colour, Piece::Type::PAWN);
+    };
+
+    // only endings against a bare king are recognised
+    const auto whitePieces = nonKingPieces(0);
+    const auto blackPieces = nonKingPieces(1);
+    if (whitePieces != 0 && blackPieces != 0)
+        return Endgame::NONE;
+    const auto strong = whitePieces != 0 ? 0 : 1;
+    strongColour = static_cast<Piece::Colour>(strong);
+    const auto strongPieces = strong == 0 ? whitePieces : blackPieces;
+
+    const auto queens = count(strong, Piece::Type::QUEEN);
+    const auto rooks = count(strong, Piece::Type::ROOK);
+    const auto bishops = count(strong, Piece::Type::BISHOP);
+    const auto knights = count(strong, Piece::Type::KNIGHT);
+    const auto pawns = count(strong, Piece::Type::PAWN);
+
+    // a lone minor piece, or two knights, can't force mate
+    if (strongPieces == 0 || (strongPieces == 1 && (bishops == 1 || knights == 1)) || (strongPieces == 2 && knights == 2))
+        return Endgame::DRAW;
+    if (queens > 0 || rooks > 0 || bishops >= 2)
+        return Endgame::KXK;
+    if (strongPieces == 2 && bishops == 1 && knights == 1)
+        return Endgame::KBNK;
+    if (strongPieces == 1 && pawns == 1)
+        return Endgame::KPK;
+    if (bishops == 1 && pawns == strongPieces - 1)
+        return Endgame::WRONGBISHOP;
+    return Endgame::NONE;
+}
+
+std::optional<int> Engine::evaluateEndgame(const GameState& gameState, const MaterialEntry& material) const {
+    using Endgame = MaterialEntry::Endgame;
+    // a won ending scores well clear of any normal material edge, so the search heads for it and then for the mate within it
+    constexpr auto knownWinBonus = 1000;
+    const auto strong = static_cast<int>(material.strongColour);
+    const auto weak = 1 - strong;
+    const auto strongKing = toVector2Int(gameState.kingSquares[strong]);
+    const auto weakKing = toVector2Int(gameState.kingSquares[weak]);
+    const auto strongPerspective = strong == 0 ? 1 : -1;
+    // the imbalance is from white's point of view, the evaluators below score from the strong side's
+    const auto strongMaterial = material.imbalance * strongPerspective;
+
+    const auto distance = [](const Vector2Int first, const Vector2Int second) {
+        return std::max(std::abs(first.x - second.x), std::abs(first.y - second.y));
+    };
+    const auto kingsCloseness = 14 - (std::abs(strongKing.x - weakKing.x) + std::abs(strongKing.y - weakKing.y));
+
+    switch (material.endgame) {
+        case Endgame::DRAW:
+            return 0;
+
+        case Endgame::KXK: {
+            // drive the bare king to the edge of the board and bring the strong king up to help mate it
+            const auto weakKingDistanceFromCentre = std::max(3 - weakKing.x, weakKing.x - 4) + std::max(3 - weakKing.y, weakKing.y - 4);
+            return (strongMaterial + knownWinBonus + 20 * weakKingDistanceFromCentre + 10 * kingsCloseness) * strongPerspective;
+        }
+
+        case Endgame::KBNK: {
+            // mate can only be forced in a corner the bishop covers, so drive the bare king towards the nearest of those two
+            const auto bishopSquare = Bitboards::leastSignificantSquare(gameState.pieceBitboards[strong][static_cast<int>(Piece::Type::BISHOP)]);
+            const auto lightSquares = (bishopSquare % 8 + bishopSquare / 8) % 2 == 0;
+            // the distance is counted in files plus ranks, so walking the king along the edge from a wrong corner still scores
+            const auto cornerDistance = [&weakKing](const Vector2Int corner) {
+                return std::abs(weakKing.x - corner.x) + std::abs(weakKing.y - corner.y);
+            };
+            const auto nearestCornerDistance = lightSquares ? std::min(cornerDistance({0, 0}), cornerDistance({7, 7}))
+                                                            : std::min(cornerDistance({7, 0}), cornerDistance({0, 7}));
+            return (strongMaterial + knownWinBonus + 20 * (14 - nearestCornerDistance) + 10 * kingsCloseness) * strongPerspective;
+        }
+
+        case Endgame::KPK: {
+            const auto pawnSquare = toVector2Int(Bitboards::leastSignificantSquare(gameState.pieceBitboards[strong][static_cast<int>(Piece::Type::PAWN)]));
+            const auto promotionSquare = Vector2Int(pawnSquare.x, strong == 0 ? 0 : 7);
+            // a rook pawn can never be promoted once the bare king reaches the corner in front of it
+            if ((pawnSquare.x == 0 || pawnSquare.x == 7) && distance(weakKing, promotionSquare) <= 1)
+                return 0;
+
+            // rule of the square: if the bare king can't catch the pawn and the strong king isn't in its way, it promotes.
+            // a pawn on its starting rank can double push, so it is one move nearer than its distance
+            const auto startingRank = strong == 0 ? 6 : 1;
+            const auto pawnMovesToPromote = std::abs(pawnSquare.y - promotionSquare.y) - (pawnSquare.y == startingRank ? 1 : 0);
+            const auto weakKingMovesToPromotion = distance(weakKing, promotionSquare) - (static_cast<int>(gameState.moveColour) == weak ? 1 : 0);
+            const auto strongKingInTheWay = strongKing.x == pawnSquare.x && (strong == 0 ? strongKing.y < pawnSquare.y : strongKing.y > pawnSquare.y);
+            if (weakKingMovesToPromotion > pawnMovesToPromote && !strongKingInTheWay)
+                return (strongMaterial + knownWinBonus + 10 * (7 - pawnMovesToPromote)) * strongPerspective;
+            return std::nullopt;
+        }
+
+        case Endgame::WRONGBISHOP: {
+            // with every pawn on one rook file and a bishop that can't cover the promotion square, a bare king sitting in
+            // the corner can never be driven out
+            const auto pawns = gameState.pieceBitboards[strong][static_cast<int>(Piece::Type::PAWN)];
+            const auto rookFile = (pawns & ~Bitboards::fileA) == 0 ? 0 : (pawns & ~Bitboards::fileH) == 0 ? 7 : -1;
+            if (rookFile == -1)
+                return std::nullopt;
+            const auto promotionSquare = Vector2Int(rookFile, strong == 0 ? 0 : 7);
+            const auto bishopSquare = Bitboards::leastSignificantSquare(gameState.pieceBitboards[strong][static_cast<int>(Piece::Type::BISHOP)]);
+            const auto bishopCoversPromotionSquare = (bishopSquare % 8 + bishopSquare / 8) % 2 == (promotionSquare.x + promotionSquare.y) % 2;
+            if (!bishopCoversPromotionSquare && distance(weakKing, promotionSquare) <= 1)
+                return 0;
+            return std::nullopt;
+        }
+
+        case Endgame::NONE:
+            break;
+    }
+    return std::nullopt;
+}
+
+int Engine::probePawnStructure(SearchThread& thread, const GameState& gameState) const {
+    auto& entry = thread.pawnHashTable[gameState.pawnZobristHash & pawnHashMask];
+    // an empty slot has a key of 0, which is also the key of a position without pawns, whose pawn score is 0 anyway
+    if (entry.pawnHashKey != gameState.pawnZobristHash) {
+        entry.pawnHashKey = gameState.pawnZobristHash;
+        entry.evaluation = evaluatePawnStructure(gameState, Piece::Colour::WHITE) - evaluatePawnStructure(gameState, Piece::Colour::BLACK);
+    }
+    return entry.evaluation;
+}
+
+int Engine::evaluatePawnStructure(const GameState& gameState, const Piece::Colour friendlyColour) {
+    // passed pawn bonuses indexed by how many ranks the pawn has advanced from its starting rank
+    constexpr std::array passedPawnBonuses = {5, 10, 20, 35, 60, 100};
+    constexpr auto doubledPawnPenalty = 15;
+    constexpr auto isolatedPawnPenalty = 15;
+    constexpr auto backwardPawnPenalty = 10;
+
+    const auto isWhite = friendlyColour == Piece::Colour::WHITE;
+    const auto friendlyPawns = gameState.pieceBitboards[isWhite ? 0 : 1][static_cast<int>(Piece::Type::PAWN)];
+    const auto enemyPawns = gameState.pieceBitboards[isWhite ? 1 : 0][static_cast<int>(Piece::Type::PAWN)];
+    const auto enemyPawnAttacks = Bitboards::allPawnAttacks(enemyPawns, isWhite ? 1 : 0);
+
+    // spread a set of squares along their files, ahead of them (the direction this side's pawns move) or behind them
+    const auto fillForwards = [isWhite](Bitboard bitboard) {
+        if (isWhite) {
+            bitboard |= bitboard >> 8;
+            bitboard |= bitboard >> 16;
+            return bitboard | bitboard >> 32;
+        }
+        bitboard |= bitboard << 8;
+        bitboard |= bitboard << 16;
+        return bitboard | bitboard << 32;
+    };
+    const auto fillBackwards = [isWhite](Bitboard bitboard) {
+        if (isWhite) {
+            bitboard |= bitboard << 8;
+            bitboard |= bitboard << 16;
+            return bitboard | bitboard << 32;
+        }
+        bitboard |= bitboard >> 8;
+        bitboard |= bitboard >> 16;
+        return bitboard | bitboard >> 32;
+    };
+    const auto adjacentFiles = [](const Bitboard bitboard) {
+        return ((bitboard & ~Bitboards::fileA) >> 1) | ((bitboard & ~Bitboards::fileH) << 1);
+    };
 
-int Engine::evaluateKingPositionsEndgame(const GameState& gameState, const Piece::Colour friendlyColour, const float endgameWeight) const {
     auto evaluation = 0;
-    // find the squares of both king pieces
-    Vector2Int friendlyKing = {8, 8};
-    Vector2Int enemyKing = {8, 8};
-    for (auto rank = 0; rank < 8; ++rank) {
-        for (auto file = 0; file < 8; ++file) {
-            if (gameState.boardPosition[rank][file]) {
-                if (gameState.boardPosition[rank][file]->type == Piece::Type::KING) {
-                    if (gameState.boardPosition[rank][file]->colour == friendlyColour) {
-                        friendlyKing.x = file;
-                        friendlyKing.y = rank;
-                    }
-                    else {
-                        enemyKing.x = file;
-                        enemyKing.y = rank;
-                    }
-                }
-            }
+    auto pawns = friendlyPawns;
+    while (pawns) {
+        const auto square = Bitboards::popLeastSignificantSquare(pawns);
+        const auto pawn = Bitboards::squareBitboard(square);
+        const auto stopSquare = isWhite ? pawn >> 8 : pawn << 8;
+        // the squares in front of the pawn on its own file
+        const auto frontSpan = fillForwards(stopSquare);
+
+        // a pawn with another friendly pawn in front of it is doubled, so only the frontmost of the pawns on a file escapes the penalty
+        if (friendlyPawns & frontSpan)
+            evaluation -= doubledPawnPenalty;
+
+        // an isolated pawn has no friendly pawns on the files either side of it to ever defend it
+        if (!(friendlyPawns & adjacentFiles(fillForwards(pawn) | fillBackwards(pawn))))
+            evaluation -= isolatedPawnPenalty;
+        // a backward pawn has fallen behind the pawns beside it, so none can come up to defend it, and it can't advance
+        // safely either as an enemy pawn controls the square in front of it
+        else if (!(friendlyPawns & adjacentFiles(fillBackwards(pawn))) && (stopSquare & enemyPawnAttacks))
+            evaluation -= backwardPawnPenalty;
+
+        // a passed pawn has no enemy pawns in front of it on its own or the neighbouring files to stop it promoting
+        if (!(enemyPawns & (frontSpan | adjacentFiles(frontSpan)))) {
+            const auto rank = square / 8;
+            evaluation += passedPawnBonuses[isWhite ? 6 - rank : rank - 1];
         }
     }
-    if (friendlyKing == Vector2Int{8, 8} || enemyKing == Vector2Int{8, 8})
+    return evaluation;
+}
+
+int Engine::evaluateKingPositionsEndgame(const GameState& gameState, const Piece::Colour friendlyColour, const float endgameWeight) const {
+    auto evaluation = 0;
+    // find the squares of both king pieces
+    const auto enemyColour = friendlyColour == Piece::Colour::WHITE ? Piece::Colour::BLACK : Piece::Colour::WHITE;
+    constexpr auto king = static_cast<int>(Piece::Type::KING);
+    if (gameState.pieceCounts[static_cast<int>(friendlyColour)][king] == 0 || gameState.pieceCounts[static_cast<int>(enemyColour)][king] == 0)
         return 0;
+    const auto friendlyKing = toVector2Int(gameState.kingSquares[static_cast<int>(friendlyColour)]);
+    const auto enemyKing = toVector2Int(gameState.kingSquares[static_cast<int>(enemyColour)]);
 
     // calculate distance of the enemy king from the centre
     // favour positions where the enemy king is forced away from the centre as this makes it easier to checkmate in endgame
@@ -125,189 +478,352 @@ int Engine::evaluateKingPositionsEndgame(const GameState& gameState, const Piece
 
 int Engine::countMaterial(const GameState& gameState, const Piece::Colour pieceColour) const {
     auto material = 0;
-    for (auto rank = 0; rank < 8; ++rank) {
-        for (auto file = 0; file < 8; ++file) {
-            if (gameState.boardPosition[rank][file]) {
-                if (gameState.boardPosition[rank][file]->colour == pieceColour)
-                    material += pieceValues[static_cast<int>(gameState.boardPosition[rank][file]->type)];
-            }
-        }
-    }
+    const auto& pieceCounts = gameState.pieceCounts[static_cast<int>(pieceColour)];
+    for (auto type = 0; type < 6; ++type)
+        material += pieceCounts[type] * pieceValues[type];
     return material;
 }
 
 float Engine::calculateEndgameWeight(const GameState& gameState) const {
+    // queens count 4, rooks 2, bishops and knights 1, so the full starting set of pieces adds up to 24
+    constexpr std::array phaseWeights = {0, 4, 2, 1, 1, 0};
     int phase = 0;
-
-    for (int rank = 0; rank < 8; ++rank) {
-        for (int file = 0; file < 8; ++file) {
-            if (!gameState.boardPosition[rank][file])
-                continue;
-
-            switch (gameState.boardPosition[rank][file]->type) {
-            case Piece::Type::QUEEN:
-                phase += 4; break;
-            case Piece::Type::ROOK:
-                phase += 2; break;
-            case Piece::Type::BISHOP:
-                phase += 1; break;
-            case Piece::Type::KNIGHT:
-                phase += 1; break;
-            default:
-                break;
-            }
-        }
+    for (const auto& pieceCounts : gameState.pieceCounts) {
+        for (auto type = 0; type < 6; ++type)
+            phase += pieceCounts[type] * phaseWeights[type];
     }
 
     return std::clamp(1.0f - static_cast<float>(phase) / 24.0f, 0.0f, 1.0f);
 }
 
-void Engine::orderMoves(const Game& game, std::vector<Move>& moves) const {
-    for (auto& move : moves) {
+void Engine::orderMoves(const Game& game, const MoveList& moves, std::array<int, MoveList::capacity>& moveScores, const size_t startIndex) const {
+    const auto& gameState = game.getCurrentGameState();
+    const auto enemyColour = gameState.moveColour == Piece::Colour::WHITE ? Piece::Colour::BLACK : Piece::Colour::WHITE;
+    const auto enemyPawnAttacks = Bitboards::allPawnAttacks(gameState.pieceBitboards[static_cast<int>(enemyColour)][static_cast<int>(Piece::Type::PAWN)], static_cast<int>(enemyColour));
+
+    // only the moves from startIndex onwards are scored, the ones before it have already been handed out by the move picker
+    for (size_t i = startIndex; i < moves.size(); ++i) {
+        const auto& move = moves[i];
         auto moveScoreGuess = 0;
-        const auto movePiece = game.getCurrentGameState().boardPosition[move.startSquare.y][move.startSquare.x].value();
-        const auto movePieceValue = pieceValues[static_cast<int>(movePiece.type)];
+        const auto movePieceValue = pieceValues[static_cast<int>(gameState.pieceAt(move.startSquare())->type)];
+
+        if (!isQuietMove(gameState, move)) {
+            // the exchange on the end square decides whether the move wins, trades or loses material
+            if (const auto exchange = staticExchangeEvaluation(game, move); exchange >= 0) {
+                // prioritise capturing opponents most valuable pieces with our least valuable pieces
+                const auto capturePiece = gameState.pieceAt(move.endSquare());
+                const auto capturePieceType = move.flag() == Move::Flag::ENPASSANT ? Piece::Type::PAWN : capturePiece ? capturePiece->type : Piece::Type::KING;
+                moveScoreGuess = goodTacticalScore - movePieceValue;
+                if (capturePieceType != Piece::Type::KING)
+                    moveScoreGuess += 10 * pieceValues[static_cast<int>(capturePieceType)];
+                // promoting a pawn is likely to be good
+                if (move.isPromotion())
+                    moveScoreGuess += pieceValues[static_cast<int>(Piece::Type::QUEEN)];
+            }
+            else
+                moveScoreGuess = losingTacticalScore + exchange;
+        }
+        // penalise moving pieces to a square under attack by an opponent pawn
+        else if (enemyPawnAttacks & Bitboards::squareBitboard(move.endSquareIndex()))
+            moveScoreGuess -= movePieceValue;
 
-        // check if a piece will be captured on this move
-        if (game.getCurrentGameState().boardPosition[move.endSquare.y][move.endSquare.x]) {
-            const auto capturePiece = game.getCurrentGameState().boardPosition[move.endSquare.y][move.endSquare.x].value();
+        moveScores[i] = moveScoreGuess;
+    }
+}
 
-            // prioritise capturing opponents most valuable pieces with our least valuable pieces
-            moveScoreGuess = 10 * pieceValues[static_cast<int>(capturePiece.type)] - movePieceValue;
-        }
+void Engine::pickNextMove(MoveList& moves, std::array<int, MoveList::capacity>& moveScores, const size_t startIndex) {
+    // moves are picked one at a time rather than sorted up front, as most nodes cut off after the first few moves
+    auto bestIndex = startIndex;
+    for (auto i = startIndex + 1; i < moves.size(); ++i) {
+        if (moveScores[i] > moveScores[bestIndex])
+            bestIndex = i;
+    }
+    std::swap(moves[startIndex], moves[bestIndex]);
+    std::swap(moveScores[startIndex], moveScores[bestIndex]);
+}
 
-        // promoting a pawn is likely to be good
-        if (game.checkForPawnPromotionOnNextMove(game.getCurrentGameState(), move))
-            moveScoreGuess += pieceValues[static_cast<int>(Piece::Type::QUEEN)];
+int Engine::staticExchangeEvaluation(const Game& game, const Move& move) const {
+    // plays out every capture on the move's end square, each side always recapturing with its least valuable piece, and
+    // returns the material the side to move comes out with. either side may stop recapturing when it would lose by going on.
+    // pins are ignored, so this is an estimate rather than the exact result of the exchange
+    const auto& gameState = game.getCurrentGameState();
+    const auto& pieces = gameState.pieceBitboards;
+    const auto startSquare = move.startSquareIndex();
+    const auto endSquare = move.endSquareIndex();
+    const auto pawnValue = pieceValues[static_cast<int>(Piece::Type::PAWN)];
+    const auto queenValue = pieceValues[static_cast<int>(Piece::Type::QUEEN)];
+
+    // gains[n] is the material won by the side making the nth capture, assuming the exchange stops after it
+    std::array<int, 32> gains{};
+    auto occupied = gameState.occupiedBitboard & ~Bitboards::squareBitboard(startSquare);
+    auto pieceOnSquareValue = pieceValues[static_cast<int>(gameState.pieceAt(startSquare)->type)];
+    if (move.flag() == Move::Flag::ENPASSANT) {
+        // the captured pawn stands beside the capturing pawn, on the start rank and the end file
+        gains[0] = pawnValue;
+        occupied &= ~Bitboards::squareBitboard((startSquare & ~7) | (endSquare & 7));
+    }
+    else if (const auto capturedPiece = gameState.pieceAt(move.endSquare()))
+        gains[0] = pieceValues[static_cast<int>(capturedPiece->type)];
+    if (move.isPromotion()) {
+        gains[0] += queenValue - pawnValue;
+        pieceOnSquareValue = queenValue;
+    }
 
-        // penalise moving pieces to a square under attack by an opponent pawn
-        if (game.isSquareUnderAttackByPawn(game.getCurrentGameState(), move.endSquare, game.getCurrentGameState().moveColour == Piece::Colour::WHITE ? Piece::Colour::BLACK : Piece::Colour::WHITE))
-            moveScoreGuess -= movePieceValue;
+    const auto bishopsAndQueens = pieces[0][static_cast<int>(Piece::Type::BISHOP)] | pieces[0][static_cast<int>(Piece::Type::QUEEN)]
+                                | pieces[1][static_cast<int>(Piece::Type::BISHOP)] | pieces[1][static_cast<int>(Piece::Type::QUEEN)];
+    const auto rooksAndQueens = pieces[0][static_cast<int>(Piece::Type::ROOK)] | pieces[0][static_cast<int>(Piece::Type::QUEEN)]
+                              | pieces[1][static_cast<int>(Piece::Type::ROOK)] | pieces[1][static_cast<int>(Piece::Type::QUEEN)];
+    auto attackers = game.getAttackersToSquare(gameState, endSquare, occupied) & occupied;
+    auto colour = gameState.moveColour == Piece::Colour::WHITE ? 1 : 0;
+    auto depth = 0;
+
+    while (const auto sideAttackers = attackers & gameState.colourBitboards[colour]) {
+        // the piece types run from king to pawn, so walking them backwards finds the least valuable attacker first
+        auto attackerType = static_cast<int>(Piece::Type::PAWN);
+        while (!(sideAttackers & pieces[colour][attackerType]))
+            --attackerType;
+
+        ++depth;
+        gains[depth] = pieceOnSquareValue - gains[depth - 1];
+        // this capture loses material even if the exchange ends with it, and the opponent already came out ahead by stopping
+        // before it, so it would never be made and the rest of the exchange can't change the result
+        if (std::max(-gains[depth - 1], gains[depth]) < 0) {
+            --depth;
+            break;
+        }
+
+        pieceOnSquareValue = pieceValues[attackerType];
+        occupied &= ~Bitboards::squareBitboard(Bitboards::leastSignificantSquare(sideAttackers & pieces[colour][attackerType]));
+        // taking the attacker off the board can uncover a slider standing behind it
+        if (attackerType == static_cast<int>(Piece::Type::PAWN) || attackerType == static_cast<int>(Piece::Type::BISHOP) || attackerType == static_cast<int>(Piece::Type::QUEEN))
+            attackers |= Bitboards::bishopAttacks(endSquare, occupied) & bishopsAndQueens;
+        if (attackerType == static_cast<int>(Piece::Type::ROOK) || attackerType == static_cast<int>(Piece::Type::QUEEN))
+            attackers |= Bitboards::rookAttacks(endSquare, occupied) & rooksAndQueens;
+        attackers &= occupied;
+        colour ^= 1;
+    }
 
-        move.score = moveScoreGuess;
+    // work back from the end of the exchange, each side choosing between stopping and recapturing
+    while (depth > 0) {
+        gains[depth - 1] = -std::max(-gains[depth - 1], gains[depth]);
+        --depth;
     }
+    return gains[0];
+}
+
+bool Engine::isQuietMove(const GameState& gameState, const Move& move) {
+    // promotions and en passant are tactical moves even though nothing stands on their end square
+    const auto endSquare = move.endSquare();
+    return !gameState.pieceAt(endSquare) && (move.flag() == Move::Flag::NORMAL || move.flag() == Move::Flag::CASTLE);
+}
 
-    // sort moves by score value, highest first
-    std::ranges::stable_sort(moves, std::greater{}, &Move::score);
+Engine::MovePicker::MovePicker(const Engine& engine, const Game& game, const Move& ttMove, const std::array<Move, 2>& killerMoves)
+    : engine(engine), game(game), ttMove(ttMove), killerMoves(killerMoves) {}
+
+Move Engine::MovePicker::nextMove() {
+    const auto& gameState = game.getCurrentGameState();
+    switch (stage) {
+        case Stage::TTMOVE:
+            stage = Stage::GENERATETACTICAL;
+            // the tt move usually causes a cutoff on its own, so it is checked for legality directly rather than by generating every move to find it
+            if (ttMove != Move() && game.isMoveLegal(gameState, ttMove))
+                return ttMove;
+            ttMove = {};
+            [[fallthrough]];
+
+        case Stage::GENERATETACTICAL:
+            game.generateAllLegalMoves(gameState, moves, GameTypes::MoveGenerationType::TACTICAL);
+            engine.orderMoves(game, moves, moveScores, 0);
+            tacticalEnd = moves.size();
+            stage = Stage::GOODTACTICAL;
+            [[fallthrough]];
+
+        case Stage::GOODTACTICAL:
+            while (currentIndex < tacticalEnd) {
+                pickNextMove(moves, moveScores, currentIndex);
+                const auto losingCapture = moveScores[currentIndex] < 0;
+                const auto move = moves[currentIndex++];
+                if (move == ttMove)
+                    continue;
+                // every move before currentIndex has been handed out or deferred already, so the slot can be reused
+                if (losingCapture) {
+                    moves[badTacticalEnd++] = move;
+                    continue;
+                }
+                return move;
+            }
+            stage = Stage::KILLERS;
+            [[fallthrough]];
+
+        case Stage::KILLERS:
+            while (killerIndex < killerMoves.size()) {
+                // killers come from other positions, so like the tt move they have to be checked before being played.
+                // captures are skipped as they have already been tried in the tactical stages
+                const auto killer = killerMoves[killerIndex++];
+                if (killer != Move() && killer != ttMove && isQuietMove(gameState, killer) && game.isMoveLegal(gameState, killer))
+                    return killer;
+            }
+            stage = Stage::GENERATEQUIETS;
+            [[fallthrough]];
+
+        case Stage::GENERATEQUIETS:
+            game.generateAllLegalMoves(gameState, moves, GameTypes::MoveGenerationType::QUIETS);
+            engine.orderMoves(game, moves, moveScores, tacticalEnd);
+            currentIndex = tacticalEnd;
+            stage = Stage::QUIETS;
+            [[fallthrough]];
+
+        case Stage::QUIETS:
+            while (currentIndex < moves.size()) {
+                pickNextMove(moves, moveScores, currentIndex);
+                const auto move = moves[currentIndex++];
+                if (move != ttMove && move != killerMoves[0] && move != killerMoves[1])
+                    return move;
+            }
+            currentIndex = 0;
+            stage = Stage::BADTACTICAL;
+            [[fallthrough]];
+
+        case Stage::BADTACTICAL:
+            // these were deferred in score order, so they are already sorted
+            if (currentIndex < badTacticalEnd)
+                return moves[currentIndex++];
+            stage = Stage::DONE;
+            [[fallthrough]];
+
+        case Stage::DONE:
+            return {};
+    }
+    return {};
 }
 
-int Engine::search(Game& game, int alpha, const int beta, const int depthLeft, const int initialDepth, const int plyFromRoot, const std::stop_token& stopToken) {
+int Engine::search(SearchThread& thread, Game& game, int alpha, const int beta, const int depthLeft, const int initialDepth, const int plyFromRoot, const std::stop_token& stopToken) {
     if (stopToken.stop_requested())
         return alpha;
 
+    // -------------------- Draw Detection --------------------
+    // a position that has already occurred is scored as a draw straight away. whichever side benefits from the repetition
+    // can keep repeating, so searching it again would only find the same cycle. the root is skipped so there is always a move to play
+    const auto& gameState = game.getCurrentGameState();
+    if (plyFromRoot > 0 && (gameState.halfMovesSinceLastActiveMove >= 100 || game.countRepetitions(gameState, game.getCurrentZobristHashHistory()) > 0))
+        return 0;
+
     // -------------------- Transposition Table Probe --------------------
-    const auto hash = game.getCurrentGameState().zobristHash;
-    // fast lookup to find possible match in the transposition table
-    const auto& entry = transpositionTable[hash & ttMask];
-    // confirm the found entry is an exact match
-    const auto ttHit = entry.hashKey == hash;
-    Move ttMove{};
-    if (ttHit)
-        ttMove = entry.bestMove;
+    const auto hash = gameState.zobristHash;
+    const auto entry = probeTTEntry(hash);
+    Move ttMove;
+    if (entry)
+        ttMove = entry->bestMove;
 
     // only use the tt entry's value if we are not at the root
-    if (ttHit && depthLeft != initialDepth && entry.depth >= depthLeft) {
-        auto ttEvaluation = entry.evaluation;
+    if (entry && depthLeft != initialDepth && entry->depth >= depthLeft) {
+        auto ttEvaluation = entry->evaluation;
         // reverse the checkmate distance adjustment that was applied at store time
         if (ttEvaluation > mateThreshold)
             ttEvaluation -= plyFromRoot;
         else if (ttEvaluation < -mateThreshold)
             ttEvaluation += plyFromRoot;
 
-        if (entry.flag == TTEntry::Flag::EXACT || (entry.flag == TTEntry::Flag::LOWERBOUND && ttEvaluation >= beta) || (entry.flag == TTEntry::Flag::UPPERBOUND && ttEvaluation <= alpha))
+        if (entry->flag == TTEntry::Flag::EXACT || (entry->flag == TTEntry::Flag::LOWERBOUND && ttEvaluation >= beta) || (entry->flag == TTEntry::Flag::UPPERBOUND && ttEvaluation <= alpha))
             return ttEvaluation;
     }
 
     // -------------------- Depth = 0, Terminal Checks --------------------
     if (depthLeft == 0)
-        return quiescenceSearch(game, alpha, beta, plyFromRoot);
-
-    auto moves = game.generateAllLegalMoves(game.getCurrentGameState());
-    if (moves.empty()) {
-        if (game.isKingInCheck(game.getCurrentGameState(), game.getCurrentGameState().moveColour))
-            return minusInfinity + plyFromRoot;
-        return 0;
-    }
-
-    orderMoves(game, moves);
-
-    // -------------------- Move Ordering Hook: TT Move First --------------------
-    if (ttHit) {
-        const auto it = std::ranges::find_if(moves, [&ttMove](const Move& move) {
-            return move.startSquare == ttMove.startSquare
-                && move.endSquare   == ttMove.endSquare
-                && move.promotionPieceType == ttMove.promotionPieceType;
-        });
-        if (it != moves.end() && it != moves.begin())
-            std::rotate(moves.begin(), it, it + 1);
-    }
+        return quiescenceSearch(thread, game, alpha, beta, plyFromRoot);
 
     // -------------------- Main Loop (Negamax + Alpha Beta Pruning) --------------------
     const auto originalAlpha = alpha;
-    Move localBestMove{};
+    Move localBestMove;
+    auto legalMovesSearched = 0;
 
-    for (auto& move : moves) {
+    // moves are generated in stages as they are needed, starting with the tt move
+    static constexpr std::array<Move, 2> noKillerMoves{};
+    MovePicker movePicker(*this, game, ttMove, plyFromRoot < maxKillerPly ? thread.killerMoves[plyFromRoot] : noKillerMoves);
+    for (auto move = movePicker.nextMove(); move != Move(); move = movePicker.nextMove()) {
         if (stopToken.stop_requested())
             return alpha;
 
-        // engine will always promote a pawn to a queen for the time being
-        if (game.checkForPawnPromotionOnNextMove(game.getCurrentGameState(), move))
-            move.promotionPieceType = Piece::Type::QUEEN;
+        ++legalMovesSearched;
+        const auto quietMove = isQuietMove(game.getCurrentGameState(), move);
+        game.getCurrentZobristHashHistory().push_back(hash);
         const auto moveDelta = game.movePiece(game.getCurrentGameState(), move);
-        const int evaluation = -search(game, -beta, -alpha, depthLeft - 1, initialDepth, plyFromRoot + 1, stopToken);
+        const int evaluation = -search(thread, game, -beta, -alpha, depthLeft - 1, initialDepth, plyFromRoot + 1, stopToken);
         game.undoLastMove(game.getCurrentGameState(), moveDelta);
-        ++positionsEvaluated;
+        game.getCurrentZobristHashHistory().pop_back();
+        ++thread.positionsEvaluated;
+
+        // a stopped child returns without searching, so its evaluation means nothing and must not be taken as a cutoff,
+        // stored in the tt or remembered as a killer. the iteration it belongs to is thrown away at the root anyway
+        if (stopToken.stop_requested())
+            return alpha;
 
         if (evaluation > alpha) {
             alpha = evaluation;
             localBestMove = move;
             if (depthLeft == initialDepth)
-                bestMove = move;
+                thread.bestMove = move;
         }
 
         // the last move was too good, the opponent won't allow this position to be reached (by playing a different move earlier on)
         // skip remaining moves/prune branch
         if (evaluation >= beta) {
-            storeTTEntry(hash, localBestMove, beta, depthLeft, TTEntry::Flag::LOWERBOUND, plyFromRoot);
+            if (quietMove)
+                storeKillerMove(thread, move, plyFromRoot);
+            storeTTEntry(thread, hash, localBestMove, beta, depthLeft, TTEntry::Flag::LOWERBOUND, plyFromRoot);
             return beta;
         }
     }
-    storeTTEntry(hash, localBestMove, alpha, depthLeft, alpha > originalAlpha ? TTEntry::Flag::EXACT : TTEntry::Flag::UPPERBOUND, plyFromRoot);
+
+    // no legal moves, so it is either checkmate or stalemate
+    if (legalMovesSearched == 0) {
+        if (game.isKingInCheck(game.getCurrentGameState(), game.getCurrentGameState().moveColour))
+            return minusInfinity + plyFromRoot;
+        return 0;
+    }
+    storeTTEntry(thread, hash, localBestMove, alpha, depthLeft, alpha > originalAlpha ? TTEntry::Flag::EXACT : TTEntry::Flag::UPPERBOUND, plyFromRoot);
     return alpha;
 }
 
-int Engine::quiescenceSearch(Game& game, int alpha, const int beta, const int plyFromRoot) {
+int Engine::quiescenceSearch(SearchThread& thread, Game& game, int alpha, const int beta, const int plyFromRoot) {
+    const auto& gameState = game.getCurrentGameState();
+    const auto sideToMoveInCheck = game.isKingInCheck(gameState, gameState.moveColour);
 
-    const auto legalMoves = game.generateAllLegalMoves(game.getCurrentGameState());
+    // if in check then must search every move to find every possible evasion
+    // if not in check then can rely on stand pat and only search captures/tactical moves
+    MoveList moves;
+    game.generateAllLegalMoves(gameState, moves, sideToMoveInCheck ? GameTypes::MoveGenerationType::ALL : GameTypes::MoveGenerationType::TACTICAL);
 
-    // handle checkmate and stalemate
-    if (legalMoves.empty()) {
-        if (game.isKingInCheck(game.getCurrentGameState(), game.getCurrentGameState().moveColour))
+    // handle checkmate and stalemate. an empty tactical list only means stalemate if there are no quiet moves either
+    if (moves.empty()) {
+        if (sideToMoveInCheck)
             // checkmate found, use plyFromRoot to prioritise faster mates when winning and slower mates when losing
             return minusInfinity + plyFromRoot;
-        // stalemate found
-        return 0;
+        if (!game.hasAnyLegalMove(gameState))
+            // stalemate found
+            return 0;
     }
 
-    const auto sideToMoveInCheck = game.isKingInCheck(game.getCurrentGameState(), game.getCurrentGameState().moveColour);
-
     // static evaluation (stand pat)
-    auto evaluation = evaluateBoardPosition(game.getCurrentGameState());
+    auto evaluation = evaluateBoardPosition(thread, gameState);
     if (!sideToMoveInCheck) {
         if (evaluation >= beta)
             return beta;
         alpha = std::max(alpha, evaluation);
     }
 
-    // if in check then must search every move to find every possible evasion
-    // if not in check then can rely on stand pat and only search captures/tactical moves
-    auto moves = sideToMoveInCheck ? legalMoves : game.generateAllLegalMoves(game.getCurrentGameState(), true);
-    orderMoves(game, moves);
+    std::array<int, MoveList::capacity> moveScores;
+    orderMoves(game, moves, moveScores, 0);
 
     // same negamax recursive search with alpha beta pruning as the one in the main search function
-    for (auto& move : moves) {
-        const auto moveDelta = game.movePiece(game.getCurrentGameState(), move);
-        evaluation = -quiescenceSearch(game, -beta, -alpha, plyFromRoot + 1);
+    for (size_t i = 0; i < moves.size(); ++i) {
+        pickNextMove(moves, moveScores, i);
+        // captures that lose material in the exchange are very unlikely to raise alpha over the stand pat score. the moves are
+        // picked best first, so once one losing capture comes up every move left is losing too
+        if (!sideToMoveInCheck && moveScores[i] < 0)
+            break;
+        const auto moveDelta = game.movePiece(game.getCurrentGameState(), moves[i]);
+        evaluation = -quiescenceSearch(thread, game, -beta, -alpha, plyFromRoot + 1);
         game.undoLastMove(game.getCurrentGameState(), moveDelta);
 
         if (evaluation >= beta)
@@ -318,28 +834,158 @@ int Engine::quiescenceSearch(Game& game, int alpha, const int beta, const int pl
     return alpha;
 }
 
-void Engine::storeTTEntry(const uint64_t hashKey, const Move& entryBestMove, int evaluation, const int depth, const TTEntry::Flag flag, const int plyFromRoot) {
+std::unique_ptr<TTCluster[], LargePageDeleter> Engine::allocateLargePages(const size_t clusterCount) {
+    // rounded up to whole large pages, as both hugetlbfs and aligned_alloc need the size to be a multiple of the alignment
+    const auto size = (clusterCount * sizeof(TTCluster) + largePageSize - 1) / largePageSize * largePageSize;
+    void* memory = nullptr;
+#if defined(__linux__)
+    // explicit huge pages only exist if the system has reserved some, so this fails on most machines
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (memory != MAP_FAILED)
+        return {static_cast<TTCluster*>(memory), LargePageDeleter{size, true}};
+    // otherwise ask for transparent huge pages, which the kernel only treats as a hint
+    memory = std::aligned_alloc(largePageSize, size);
+    if (memory)
+        madvise(memory, size, MADV_HUGEPAGE);
+#elif defined(_WIN32)
+    // large pages on windows need the lock pages in memory privilege, which normal users don't have, so the table is
+    // only aligned to where they would start
+    memory = _aligned_malloc(size, largePageSize);
+#else
+    memory = std::aligned_alloc(largePageSize, size);
+#endif
+    if (!memory)
+        throw std::bad_alloc();
+    return {static_cast<TTCluster*>(memory), LargePageDeleter{size, false}};
+}
+
+void Engine::clearTranspositionTable() {
+    // each thread value initialises its own share of the clusters. the same pass also constructs the entries in freshly
+    // allocated memory, and for a multi-gigabyte table a single thread would spend seconds doing it
+    const auto clearingThreadCount = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    const auto clustersPerThread = (ttClusterCount + clearingThreadCount - 1) / clearingThreadCount;
+    std::vector<std::jthread> clearingThreads;
+    for (size_t i = 0; i < clearingThreadCount; ++i) {
+        const auto first = std::min(i * clustersPerThread, ttClusterCount);
+        const auto last = std::min(first + clustersPerThread, ttClusterCount);
+        clearingThreads.emplace_back([this, first, last] {
+            std::uninitialized_value_construct(transpositionTable.get() + first, transpositionTable.get() + last);
+        });
+    }
+}
+
+std::optional<TTEntry> Engine::probeTTEntry(const uint64_t hashKey) const {
+    // the low bits of the key pick the cluster, and the top bits are checked against each entry in it
+    for (const auto& storedEntry : transpositionTable[hashKey & (ttClusterCount - 1)].entries) {
+        if (const auto data = storedEntry.load(std::memory_order_relaxed); data != 0 && TTEntry::matches(data, hashKey))
+            return TTEntry::unpack(data, infinity);
+    }
+    return std::nullopt;
+}
+
+int Engine::calculateHashfull() const {
+    // uci reports how full the table is in permille, estimated from the first thousand entries. only entries from the
+    // current search count, as the older ones are there to be replaced
+    const auto sampledClusters = std::min(1000 / TTCluster::entryCount, ttClusterCount);
+    size_t usedEntries = 0;
+    for (size_t i = 0; i < sampledClusters; ++i) {
+        for (const auto& storedEntry : transpositionTable[i].entries) {
+            const auto data = storedEntry.load(std::memory_order_relaxed);
+            if (data != 0 && TTEntry::unpack(data, infinity).generation == ttGeneration)
+                ++usedEntries;
+        }
+    }
+    return static_cast<int>(usedEntries * 1000 / (sampledClusters * TTCluster::entryCount));
+}
+
+void Engine::storeTTEntry(SearchThread& thread, const uint64_t hashKey, const Move& entryBestMove, int evaluation, const int depth, const TTEntry::Flag flag, const int plyFromRoot) {
     if (evaluation > mateThreshold)
         evaluation += plyFromRoot;
     else if (evaluation < -mateThreshold)
         evaluation -= plyFromRoot;
 
-    transpositionTable[hashKey & ttMask] = TTEntry{hashKey, entryBestMove, evaluation, static_cast<int16_t>(depth), flag};
-    ++transpositions;
+    // the position's own entry is reused if it is already in the cluster, otherwise an empty entry is taken, and failing
+    // that the least valuable entry is replaced. an entry's value is its depth, minus a penalty for every search since it
+    // was stored, so deep entries survive the shallow ones near the leaves but are still replaced once they go stale
+    const auto entryValue = [this](const TTEntry& entry) {
+        const auto age = (ttGeneration - entry.generation + ttGenerations) % ttGenerations;
+        return entry.depth - 8 * age;
+    };
+    auto& cluster = transpositionTable[hashKey & (ttClusterCount - 1)];
+    auto* replacedEntry = &cluster.entries[0];
+    auto replacedValue = std::numeric_limits<int>::max();
+    for (auto& storedEntry : cluster.entries) {
+        const auto data = storedEntry.load(std::memory_order_relaxed);
+        if (data == 0) {
+            replacedEntry = &storedEntry;
+            break;
+        }
+        const auto existingEntry = TTEntry::unpack(data, infinity);
+        if (TTEntry::matches(data, hashKey)) {
+            // a deeper result for the same position from this search is only overwritten by an exact score
+            if (flag != TTEntry::Flag::EXACT && existingEntry.generation == ttGeneration && existingEntry.depth > depth)
+                return;
+            replacedEntry = &storedEntry;
+            break;
+        }
+        if (const auto value = entryValue(existingEntry); value < replacedValue) {
+            replacedEntry = &storedEntry;
+            replacedValue = value;
+        }
+    }
+
+    replacedEntry->store(TTEntry{entryBestMove, evaluation, static_cast<uint8_t>(depth), flag, ttGeneration}.pack(hashKey, infinity), std::memory_order_relaxed);
+    ++thread.transpositions;
+}
+
+void Engine::storeKillerMove(SearchThread& thread, const Move& move, const int plyFromRoot) {
+    if (plyFromRoot >= maxKillerPly)
+        return;
+    // the newest killer goes first, pushing the older one into the second slot
+    auto& killers = thread.killerMoves[plyFromRoot];
+    if (killers[0] != move) {
+        killers[1] = killers[0];
+        killers[0] = move;
+    }
+}
+
+void Engine::setPerftHashSize(const size_t megabytes) {
+    perftHashMegabytes = megabytes;
+}
+
+void Engine::setThreadCount(const size_t count) {
+    threadCount = std::max<size_t>(count, 1);
 }
 
-std::uint64_t Engine::perft(Game& game, const int depth) const {
+void Engine::setHashSize(const size_t megabytes) {
+    // the table always has at least one cluster
+    hashMegabytes = std::max<size_t>(megabytes, 1);
+}
+
+std::uint64_t Engine::perft(Game& game, const int depth) {
     // perft counts legal move tree size only; it should not evaluate positions or apply search heuristics.
     // depth 0 means "the current position itself is one leaf node".
     if (depth == 0)
         return 1;
-
-    // generate the exact legal children from this position, including all promotion variants.
-    const auto moves = generatePerftMoves(game);
-    // once we are one ply away from the leaves, the node count is just the number of legal moves.
+    // once we are one ply away from the leaves, the node count is just the number of legal moves, which the generator can
+    // count straight from its bitboards without building the moves themselves
     if (depth == 1)
-        return moves.size();
+        return game.countLegalMoves(game.getCurrentGameState());
+
+    // the same position can be reached by different move orders, so a subtree already counted at this depth is looked up
+    // rather than counted again. the depth is mixed into the key as the same position has a different count at each depth
+    const auto key = game.getCurrentGameState().zobristHash ^ (static_cast<uint64_t>(depth) * 0x9E3779B97F4A7C15ULL);
+    PerftHashEntry* entry = nullptr;
+    if (!perftHashTable.empty()) {
+        entry = &perftHashTable[key & (perftHashTable.size() - 1)];
+        const auto storedNodes = entry->nodes.load(std::memory_order_relaxed);
+        if ((entry->keyXorNodes.load(std::memory_order_relaxed) ^ storedNodes) == key)
+            return storedNodes;
+    }
 
+    // generate the exact legal children from this position, including all promotion variants.
+    MoveList moves;
+    generatePerftMoves(game, moves);
     std::uint64_t nodes = 0;
     for (const auto& move : moves) {
         // standard recursive perft flow: make move, count descendants, then undo before trying the next sibling.
@@ -347,10 +993,15 @@ std::uint64_t Engine::perft(Game& game, const int depth) const {
         nodes += perft(game, depth - 1);
         game.undoLastMove(game.getCurrentGameState(), moveDelta);
     }
+
+    if (entry) {
+        entry->keyXorNodes.store(key ^ nodes, std::memory_order_relaxed);
+        entry->nodes.store(nodes, std::memory_order_relaxed);
+    }
     return nodes;
 }
 
-std::vector<Move> Engine::generatePerftMoves(const Game& game) const {
+void Engine::generatePerftMoves(const Game& game, MoveList& perftMoves) const {
     // perft must treat each promotion piece as a separate legal move, whereas the search currently defaults promotions to queens.
     static const std::array promotionPieceTypes = {
         Piece::Type::QUEEN,
@@ -359,19 +1010,17 @@ std::vector<Move> Engine::generatePerftMoves(const Game& game) const {
         Piece::Type::KNIGHT
     };
 
-    std::vector<Move> perftMoves;
-    for (const auto& move : game.generateAllLegalMoves(game.getCurrentGameState())) {
-        if (game.checkForPawnPromotionOnNextMove(game.getCurrentGameState(), move)) {
+    MoveList legalMoves;
+    game.generateAllLegalMoves(game.getCurrentGameState(), legalMoves);
+    perftMoves.clear();
+    for (const auto& move : legalMoves) {
+        if (move.isPromotion()) {
             // a single legal promotion square expands into four separate UCI/legal moves: q, r, b and n.
-            for (const auto promotionPieceType : promotionPieceTypes) {
-                auto promotionMove = move;
-                promotionMove.promotionPieceType = promotionPieceType;
-                perftMoves.emplace_back(promotionMove);
-            }
+            for (const auto promotionPieceType : promotionPieceTypes)
+                perftMoves.emplace_back(move.startSquareIndex(), move.endSquareIndex(), Move::Flag::PROMOTION, promotionPieceType);
         }
         // non-promotion moves can be forwarded unchanged.
         else
             perftMoves.emplace_back(move);
     }
-    return perftMoves;
 }
@@ -1,7 +1,10 @@
 #ifndef CHESS_ENGINE_H
 #define CHESS_ENGINE_H
 #include "game.h"
+#include <algorithm>
+#include <atomic>
 #include <map>
+#include <memory>
 #include <thread>
 
 struct EngineSearchSettings {
@@ -13,45 +16,221 @@ struct EngineSearchSettings {
 
 struct TTEntry
 {
-    uint64_t hashKey;
     Move bestMove;
     int evaluation;
-    int16_t depth;
+    uint8_t depth;
     enum class Flag : uint8_t {EXACT, LOWERBOUND, UPPERBOUND} flag;
+    // the search that stored the entry, counting up from 0 to 63 and then wrapping back round
+    uint8_t generation;
+
+    // evaluations are stored in 16 bits. ordinary evaluations are nowhere near the limit, and mate scores (within 1000 of
+    // infinity) keep their distance to mate at the very top of the range
+    static constexpr int maxStoredEvaluation = 32767;
+    static constexpr int mateStoredEvaluation = maxStoredEvaluation - 1000;
+
+    // the whole entry fits in one word, so it is stored and loaded with a single atomic access and can never be torn.
+    // the move is in the low 16 bits, then the evaluation, the depth, the flag and generation sharing a byte, and the top
+    // 16 bits of the position's hash, the low bits being implied by where the entry is in the table
+    [[nodiscard]] uint64_t pack(const uint64_t hashKey, const int infinity) const {
+        auto storedEvaluation = std::clamp(evaluation, -mateStoredEvaluation, mateStoredEvaluation);
+        if (evaluation > infinity - 1000)
+            storedEvaluation = maxStoredEvaluation - (infinity - evaluation);
+        else if (evaluation < -(infinity - 1000))
+            storedEvaluation = -maxStoredEvaluation + (infinity + evaluation);
+        // a mate bound inherited from an ancestor can be shifted past infinity by the distance adjustment, and must not
+        // wrap round to the other side's mate
+        storedEvaluation = std::clamp(storedEvaluation, -maxStoredEvaluation, maxStoredEvaluation);
+        return bestMove.encodedMove | static_cast<uint64_t>(static_cast<uint16_t>(storedEvaluation)) << 16
+            | static_cast<uint64_t>(depth) << 32 | static_cast<uint64_t>(flag) << 40 | static_cast<uint64_t>(generation) << 42
+            | (hashKey & 0xFFFF000000000000ULL);
+    }
+
+    [[nodiscard]] static bool matches(const uint64_t data, const uint64_t hashKey) {
+        return data >> 48 == hashKey >> 48;
+    }
+
+    [[nodiscard]] static TTEntry unpack(const uint64_t data, const int infinity) {
+        TTEntry entry{};
+        entry.bestMove.encodedMove = static_cast<uint16_t>(data);
+        entry.evaluation = static_cast<int16_t>(data >> 16);
+        if (entry.evaluation > mateStoredEvaluation)
+            entry.evaluation = infinity - (maxStoredEvaluation - entry.evaluation);
+        else if (entry.evaluation < -mateStoredEvaluation)
+            entry.evaluation = -infinity + (maxStoredEvaluation + entry.evaluation);
+        entry.depth = static_cast<uint8_t>(data >> 32);
+        entry.flag = static_cast<Flag>(data >> 40 & 0x3);
+        entry.generation = static_cast<uint8_t>(data >> 42 & 0x3F);
+        return entry;
+    }
+};
+
+// a position can be stored in any of the entries of the cluster its hash picks. every search thread reads and writes them
+// without locking. four 8 byte entries make a 32 byte cluster, so a probe or a store never crosses a cache line
+struct alignas(32) TTCluster
+{
+    static constexpr size_t entryCount = 4;
+    std::array<std::atomic<uint64_t>, entryCount> entries;
+};
+
+// frees memory from Engine::allocateLargePages. memory mapped from hugetlbfs has to be unmapped rather than freed, so the
+// deleter remembers how the memory was allocated
+struct LargePageDeleter
+{
+    size_t size = 0;
+    bool mapped = false;
+    void operator()(void* memory) const;
+};
+
+struct MaterialEntry
+{
+    uint64_t materialKey;
+    // material balance from white's point of view, including the bishop pair
+    int imbalance;
+    float endgameWeight;
+    // endings that are scored by their own evaluator rather than the general evaluation
+    enum class Endgame : uint8_t {NONE, DRAW, KXK, KBNK, KPK, WRONGBISHOP} endgame;
+    // the side with the extra material in a recognised endgame, the other side has a bare king
+    Piece::Colour strongColour;
+};
+
+// the key and the node count are stored xored together, so an entry torn by two perft threads writing it at the same
+// time fails to match instead of handing back another position's count
+struct PerftHashEntry
+{
+    std::atomic<uint64_t> keyXorNodes;
+    std::atomic<uint64_t> nodes;
+};
+
+struct PawnHashEntry
+{
+    uint64_t pawnHashKey;
+    // white's pawn structure score minus black's
+    int evaluation;
 };
 
 class Engine {
     const std::array<int, 6> pieceValues = {20000, 900, 500, 330, 320, 100};
     static constexpr int minusInfinity = -999999;
     static constexpr int infinity = 999999;
-    Move bestMove = {};
-    int positionsEvaluated = 0;
-    int transpositions = 0;
+    // tactical moves that don't lose material in the exchange are ordered ahead of every quiet move and the losing ones after
+    // them, so in the tactical stages a negative score is exactly a losing capture
+    static constexpr int goodTacticalScore = 1000000;
+    static constexpr int losingTacticalScore = -1000000;
 
     // transposition table attributes
     static constexpr int mateThreshold = infinity - 1000;
-    static constexpr size_t ttSize = 1 << 20;
-    static constexpr uint64_t ttMask = ttSize - 1;
-    std::vector<TTEntry> transpositionTable = std::vector<TTEntry>(ttSize);
+    static constexpr int ttGenerations = 64;
+    // allocated by the first search rather than on construction, so starting the engine up doesn't pay for zeroing it, and
+    // again whenever its size has been changed. it is the only table every search thread shares. it is probed at random,
+    // so it is backed by large pages where possible to keep the probes from missing the tlb as well as the cache
+    static constexpr size_t defaultHashMegabytes = 16;
+    size_t hashMegabytes = defaultHashMegabytes;
+    std::unique_ptr<TTCluster[], LargePageDeleter> transpositionTable;
+    size_t ttClusterCount = 0;
+    // bumped by every search. entries from older searches are the first to be replaced, so results from earlier searches
+    // age out of the table during a game without it having to be cleared
+    uint8_t ttGeneration = 0;
+
+    // pawn structure scores cached by pawn zobrist hash. the pawns rarely change from one node to the next, so nearly every
+    // evaluation finds its pawn score here instead of working it out again
+    static constexpr size_t pawnHashSize = 1 << 14;
+    static constexpr uint64_t pawnHashMask = pawnHashSize - 1;
+
+    // material evaluations cached by material key. the material on the board changes only on captures and promotions
+    static constexpr int materialTableBits = 13;
+
+    // killer moves are quiet moves that caused a beta cutoff at the same ply elsewhere in the tree, two are kept per ply
+    static constexpr int maxKillerPly = 128;
+
+    // everything a search thread writes to apart from the transposition table, so the threads never touch each other's.
+    // the pawn and material tables are small enough that giving each thread its own copy is cheaper than sharing them
+    struct SearchThread {
+        Move bestMove = {};
+        // the result of the last iteration the thread finished, which is what it votes for at the end of the search
+        Move completedBestMove = {};
+        int completedEvaluation = 0;
+        int completedDepth = 0;
+        int positionsEvaluated = 0;
+        int transpositions = 0;
+        std::array<std::array<Move, 2>, maxKillerPly> killerMoves{};
+        std::vector<PawnHashEntry> pawnHashTable;
+        std::vector<MaterialEntry> materialTable;
+    };
+    // lazy smp: every thread runs its own iterative deepening on the same root, sharing what it finds only through the
+    // transposition table. thread 0 is the main thread, the search finishes when it does. allocated by the first search
+    // empty until set with the Threads option, the search then runs on one thread and perft on every core
+    std::optional<size_t> threadCount;
+    std::vector<SearchThread> searchThreads;
+
+    // perft subtree sizes keyed by position and remaining depth, shared by every perft thread. 0 megabytes turns it off
+    static constexpr size_t defaultPerftHashMegabytes = 16;
+    size_t perftHashMegabytes = defaultPerftHashMegabytes;
+    std::vector<PerftHashEntry> perftHashTable;
+
+    class MovePicker;
 
 public:
     void reset();
     Move generateEngineMove(const Game& game, const EngineSearchSettings& engineSearchSettings, const std::stop_token& stopToken);
-    [[nodiscard]] std::vector<std::pair<Move, std::uint64_t>> generatePerftDivide(const Game& game, int depth) const;
+    [[nodiscard]] std::vector<std::pair<Move, std::uint64_t>> generatePerftDivide(const Game& game, int depth);
+    void setPerftHashSize(size_t megabytes);
+    void setThreadCount(size_t count);
+    void setHashSize(size_t megabytes);
 
 private:
-    [[nodiscard]] int evaluateBoardPosition(const GameState& gameState) const;
+    void iterativeDeepening(const Game& game, SearchThread& thread, size_t threadIndex, const Move& firstLegalMove, int maxSearchDepth, const std::stop_token& stopToken);
+    [[nodiscard]] int evaluateBoardPosition(SearchThread& thread, const GameState& gameState) const;
+    [[nodiscard]] int probePawnStructure(SearchThread& thread, const GameState& gameState) const;
+    [[nodiscard]] const MaterialEntry& probeMaterial(SearchThread& thread, const GameState& gameState) const;
+    [[nodiscard]] static MaterialEntry::Endgame classifyEndgame(const GameState& gameState, Piece::Colour& strongColour);
+    [[nodiscard]] std::optional<int> evaluateEndgame(const GameState& gameState, const MaterialEntry& material) const;
+    [[nodiscard]] static int evaluatePawnStructure(const GameState& gameState, Piece::Colour friendlyColour);
     [[nodiscard]] int evaluateKingPositionsEndgame(const GameState& gameState, Piece::Colour friendlyColour, float endgameWeight) const;
     [[nodiscard]] int countMaterial(const GameState& gameState, Piece::Colour pieceColour) const;
     [[nodiscard]] float calculateEndgameWeight(const GameState& gameState) const;
-    void orderMoves (const Game& game, std::vector<Move>& moves) const;
-    int search(Game& game, int alpha, int beta, int depthLeft, int initialDepth, int plyFromRoot, const std::stop_token& stopToken);
-    int quiescenceSearch(Game& game, int alpha, int beta, int plyFromRoot);
-    void storeTTEntry(uint64_t hashKey, const Move& entryBestMove, int evaluation, int depth, TTEntry::Flag flag, int plyFromRoot);
+    void orderMoves(const Game& game, const MoveList& moves, std::array<int, MoveList::capacity>& moveScores, size_t startIndex) const;
+    [[nodiscard]] int staticExchangeEvaluation(const Game& game, const Move& move) const;
+    [[nodiscard]] static bool isQuietMove(const GameState& gameState, const Move& move);
+    static void pickNextMove(MoveList& moves, std::array<int, MoveList::capacity>& moveScores, size_t startIndex);
+    int search(SearchThread& thread, Game& game, int alpha, int beta, int depthLeft, int initialDepth, int plyFromRoot, const std::stop_token& stopToken);
+    int quiescenceSearch(SearchThread& thread, Game& game, int alpha, int beta, int plyFromRoot);
+    [[nodiscard]] static std::unique_ptr<TTCluster[], LargePageDeleter> allocateLargePages(size_t clusterCount);
+    void clearTranspositionTable();
+    [[nodiscard]] std::optional<TTEntry> probeTTEntry(uint64_t hashKey) const;
+    [[nodiscard]] int calculateHashfull() const;
+    void storeTTEntry(SearchThread& thread, uint64_t hashKey, const Move& entryBestMove, int evaluation, int depth, TTEntry::Flag flag, int plyFromRoot);
+    static void storeKillerMove(SearchThread& thread, const Move& move, int plyFromRoot);
 
     // performance testing
-    [[nodiscard]] std::uint64_t perft(Game& game, int depth) const;
-    [[nodiscard]] std::vector<Move> generatePerftMoves(const Game& game) const;
+    [[nodiscard]] std::uint64_t perft(Game& game, int depth);
+    void generatePerftMoves(const Game& game, MoveList& perftMoves) const;
+};
+
+// hands out the moves of one search node a stage at a time, only generating and scoring the next group of moves once the
+// previous group has run out. most nodes cut off on the first or second move, so the later stages are usually never reached
+class Engine::MovePicker {
+public:
+    MovePicker(const Engine& engine, const Game& game, const Move& ttMove, const std::array<Move, 2>& killerMoves);
+    // returns an empty move once every legal move has been handed out
+    Move nextMove();
+
+private:
+    enum class Stage {TTMOVE, GENERATETACTICAL, GOODTACTICAL, KILLERS, GENERATEQUIETS, QUIETS, BADTACTICAL, DONE};
+
+    const Engine& engine;
+    const Game& game;
+    Move ttMove;
+    std::array<Move, 2> killerMoves;
+    Stage stage = Stage::TTMOVE;
+
+    // the tactical moves are generated first and the quiets are appended after them. captures that look like they lose
+    // material are moved down to the front of the list as the good ones are handed out, and are tried last of all
+    MoveList moves;
+    std::array<int, MoveList::capacity> moveScores;
+    size_t currentIndex = 0;
+    size_t tacticalEnd = 0;
+    size_t badTacticalEnd = 0;
+    size_t killerIndex = 0;
 };
 
 #endif //CHESS_ENGINE_H
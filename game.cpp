@@ -1,48 +1,58 @@
 #include "game.h"
 #include <algorithm>
 #include <iostream>
-#include <random>
 #include <ranges>
 
-ZobristHashKeys Game::generateZobristHashKeys() {
-    // set up rng
-    constexpr uint64_t zobristSeed = 42;
-    std::mt19937_64 rng(zobristSeed);
-
-    // initialise hash keys
-    ZobristHashKeys zobristHashKeys;
-    for (auto i = 0; i < 64; ++i) {
-        for (auto j = 0; j < 6; ++j) {
-            for (auto k = 0; k < 2; ++k)
-                zobristHashKeys.boardHash[i][j][k] = rng();
-        }
-    }
-    for (auto i = 0; i < 8; ++i)
-        zobristHashKeys.enPassantFileHash[i] = rng();
-    for (auto i = 0; i < 4; ++i)
-        zobristHashKeys.castlingRightsHash[i] = rng();
-    zobristHashKeys.turnHash = rng();
-
-    return zobristHashKeys;
+namespace {
+    // everything about a side that move generation and make/unmake depend on. the functions that branch on the side to move
+    // are instantiated once per colour with these as compile time constants, and only look at the colour once per call
+    template<Piece::Colour Us>
+    struct ColourTraits {
+        static constexpr bool isWhite = Us == Piece::Colour::WHITE;
+        static constexpr Piece::Colour them = isWhite ? Piece::Colour::BLACK : Piece::Colour::WHITE;
+        static constexpr int index = isWhite ? 0 : 1;
+        static constexpr int enemyIndex = isWhite ? 1 : 0;
+        // the square index step of a single pawn push
+        static constexpr int forwardStep = isWhite ? -8 : 8;
+        static constexpr Bitboard doublePushStartRank = isWhite ? Bitboards::rank6 : Bitboards::rank1;
+        static constexpr Bitboard promotionRank = isWhite ? Bitboards::rank0 : Bitboards::rank7;
+        static constexpr int kingStartSquare = toSquareIndex(isWhite ? whiteKingStartSquare : blackKingStartSquare);
+        // indices into gameState.castlingRights, ordered {WQ, WK, BQ, BK}
+        static constexpr int queensideCastlingIndex = isWhite ? 0 : 2;
+        static constexpr int kingsideCastlingIndex = isWhite ? 1 : 3;
+        static constexpr GameTypes::CastleType queensideCastle = isWhite ? GameTypes::CastleType::WHITEQUEENSIDE : GameTypes::CastleType::BLACKQUEENSIDE;
+        static constexpr GameTypes::CastleType kingsideCastle = isWhite ? GameTypes::CastleType::WHITEKINGSIDE : GameTypes::CastleType::BLACKKINGSIDE;
+        static constexpr int queensideRookStartSquare = toSquareIndex(isWhite ? whiteQueensideRookStartSquare : blackQueensideRookStartSquare);
+        static constexpr int queensideRookEndSquare = toSquareIndex(isWhite ? whiteQueensideRookEndSquare : blackQueensideRookEndSquare);
+        static constexpr int kingsideRookStartSquare = toSquareIndex(isWhite ? whiteKingsideRookStartSquare : blackKingsideRookStartSquare);
+        static constexpr int kingsideRookEndSquare = toSquareIndex(isWhite ? whiteKingsideRookEndSquare : blackKingsideRookEndSquare);
+    };
 }
 
 std::vector<Vector2Int> Game::generateLegalMovesForSquare(const GameState& gameState,  const Vector2Int startSquare) const {
-    std::vector<Vector2Int> validMovableSquares;
-    for (int rank = 0; rank < 8; ++rank) {
-        for (int file = 0; file < 8; ++file) {
-            if (const auto move = Move(startSquare, Vector2Int(file, rank)); isMoveLegal(gameState, move))
-                validMovableSquares.emplace_back(file, rank);
-        }
+    if (!legalMoveCache.valid || legalMoveCache.zobristHash != gameState.zobristHash) {
+        MoveList legalMoves;
+        generateAllLegalMoves(gameState, legalMoves);
+        legalMoveCache.endSquares = {};
+        for (const auto& move : legalMoves)
+            legalMoveCache.endSquares[move.startSquareIndex()] |= Bitboards::squareBitboard(move.endSquareIndex());
+        legalMoveCache.zobristHash = gameState.zobristHash;
+        legalMoveCache.valid = true;
     }
+
+    std::vector<Vector2Int> validMovableSquares;
+    auto endSquares = legalMoveCache.endSquares[toSquareIndex(startSquare)];
+    while (endSquares)
+        validMovableSquares.emplace_back(toVector2Int(Bitboards::popLeastSignificantSquare(endSquares)));
     return validMovableSquares;
 }
 
 void Game::reset() {
     currentGameState.reset();
-    currentGameStateHistory.clear();
+    currentZobristHashHistory.clear();
 }
 
-bool Game::populateGameStateFromFEN(GameState& gameState, std::vector<GameState>& gameStateHistory, const std::string& fen) const {
+bool Game::populateGameStateFromFEN(GameState& gameState, std::vector<uint64_t>& zobristHashHistory, const std::string& fen) const {
     gameState.reset();
 
     // tokenise the fen string so the 6 pieces of information can be handled individually
@@ -114,7 +124,7 @@ bool Game::populateGameStateFromFEN(GameState& gameState, std::vector<GameState>
                     std::cerr << "FEN board position contains invalid character" << std::endl;
                     return false;
             }
-            gameState.boardPosition[row][column] = Piece(pieceType, std::isupper(unsignedCharacter) ? Piece::Colour::WHITE : Piece::Colour::BLACK);
+            gameState.placePiece(Piece(pieceType, std::isupper(unsignedCharacter) ? Piece::Colour::WHITE : Piece::Colour::BLACK), Vector2Int(column, row));
             ++column;
         }
         else {
@@ -197,7 +207,7 @@ bool Game::populateGameStateFromFEN(GameState& gameState, std::vector<GameState>
     }
     // if pos is the same as the number of characters in the token, then every character in the token was a digit
     if (pos == fenTokens[4].length())
-        gameState.halfMoveCounter = halfMoveCount;
+        gameState.halfMovesSinceLastActiveMove = halfMoveCount;
     else {
         std::cerr << "FEN half move count invalid" << std::endl;
         return false;
@@ -225,51 +235,45 @@ bool Game::populateGameStateFromFEN(GameState& gameState, std::vector<GameState>
         std::cerr << "FEN full move count invalid" << std::endl;
         return false;
     }
+    // halfMoveCounter counts every half move of the game, and is odd whenever black is to move
+    gameState.halfMoveCounter = std::max(fullMoveCount - 1, 0) * 2 + (gameState.moveColour == Piece::Colour::BLACK ? 1 : 0);
 
     gameState.zobristHash = generateZobristHash(gameState);
-    gameStateHistory.emplace_back(gameState);
+    gameState.pawnZobristHash = generatePawnZobristHash(gameState);
+    gameState.checkersBitboard = calculateCheckers(gameState);
+    // nothing from before the fen's position is known, so it can't be repeated
+    zobristHashHistory.clear();
     return true;
 }
 
-bool Game::pickupPieceFromBoard(GameState& gameState, const Vector2Int startSquare) const {
-    // check there is a piece at the start square
-    if (!gameState.boardPosition[startSquare.y][startSquare.x])
-        return false;
-
-    gameState.selectedPieceStartSquare = startSquare;
-    gameState.selectedPiece = gameState.boardPosition[startSquare.y][startSquare.x];
-
-    // check the piece is the same colour as the colour of whose turn it is
-    if (gameState.selectedPiece->colour != gameState.moveColour) {
-        gameState.selectedPieceStartSquare = std::nullopt;
-        gameState.selectedPiece = std::nullopt;
-        return false;
-    }
-    return true;
+bool Game::canPickupPieceFromBoard(const GameState& gameState, const Vector2Int startSquare) const {
+    // check there is a piece at the start square, and that it is the same colour as the colour of whose turn it is
+    const auto piece = gameState.pieceAt(startSquare);
+    return piece && piece->colour == gameState.moveColour;
 }
 
 // TODO: this function is only used for ChessGUI, not ChessUCI. It can be only used from main.cpp currently, all other classes that want to move pieces have to manually call checkIsMoveLegal() first.
 // TODO: it needs to be rewritten to be more clear about what its actually doing and to make it available to other classes if necessary.
-GameTypes::MoveType Game::placePieceOnBoard(GameState& gameState, const Vector2Int endSquare, std::vector<GameState>& gameStateHistory, const Piece* pawnPromotionChoice) const {
+GameTypes::MoveType Game::placePieceOnBoard(GameState& gameState, const std::optional<Vector2Int> startSquare, const Vector2Int endSquare, std::vector<uint64_t>& zobristHashHistory, const Piece* pawnPromotionChoice) const {
     auto moveType = GameTypes::MoveType::NONE;
 
-    // ensure the piece and the piece start square will be valid for all the functions that need them and get called from this function
-    if (!gameState.selectedPieceStartSquare)
+    // ensure the piece and the piece start square will be valid for all the functions that need them and get called from this function.
+    // the start square is the square of the piece the gui has selected, if any
+    if (!startSquare)
         return moveType;
-    if (!gameState.boardPosition[gameState.selectedPieceStartSquare.value().y][gameState.selectedPieceStartSquare.value().x])
+    if (!gameState.pieceAt(startSquare.value()))
         return moveType;
 
-    // determine if piece can move to this square and move it if so
-    auto move = Move(gameState.selectedPieceStartSquare.value(), endSquare);
+    // determine if piece can move to this square and move it if so.
+    // the promotion choice is only applied if this move actually promotes a pawn
+    const auto move = createMove(gameState, startSquare.value(), endSquare, pawnPromotionChoice ? std::optional(pawnPromotionChoice->type) : std::nullopt);
     // moveDelta is populated only when the move was legal and applied. it carries everything
     // needed to derive moveType post-hoc (capture / castle / promotion attribution).
     std::optional<MoveDelta> moveDelta;
     if (isMoveLegal(gameState, move)) {
-        if (pawnPromotionChoice)
-            move.promotionPieceType = pawnPromotionChoice->type;
-        // GUI code maintains the full gameStateHistory for threefold repetition;
-        // push the pre-move snapshot before mutating gameState.
-        gameStateHistory.emplace_back(gameState);
+        // GUI code maintains the zobrist hash history for threefold repetition;
+        // push the pre-move hash before mutating gameState.
+        zobristHashHistory.emplace_back(gameState.zobristHash);
         moveDelta = movePiece(gameState, move);
     }
 
@@ -290,7 +294,9 @@ GameTypes::MoveType Game::placePieceOnBoard(GameState& gameState, const Vector2I
         moveType = GameTypes::MoveType::CHECK;
 
     // check for stalemate and checkmate
-    if (generateAllLegalMoves(gameState).empty()) {
+    MoveList legalMoves;
+    generateAllLegalMoves(gameState, legalMoves);
+    if (legalMoves.empty()) {
         moveType = GameTypes::MoveType::GAMEOVER;
         if (isKingInCheck(gameState, gameState.moveColour)) {
             if (gameState.moveColour == Piece::Colour::WHITE)
@@ -302,43 +308,32 @@ GameTypes::MoveType Game::placePieceOnBoard(GameState& gameState, const Vector2I
             gameState.gameOverType = GameTypes::GameOverType::STALEMATE;
     }
 
-    // check for how many times this gamestate (specifically board position) has appeared, if it is 3 or more then the game is drawn by threefold repetition
-    auto gameStateFrequency = 0;
-    for (const auto& previousGameState : gameStateHistory) {
-        if (gameState == previousGameState) {
-            ++gameStateFrequency;
-            if (gameStateFrequency >= 3) {
-                moveType = GameTypes::MoveType::GAMEOVER;
-                gameState.gameOverType = GameTypes::GameOverType::TFRDRAW;
-            }
-        }
+    // if this position has appeared twice before then this is its third appearance and the game is drawn by threefold repetition
+    if (countRepetitions(gameState, zobristHashHistory) >= 2) {
+        moveType = GameTypes::MoveType::GAMEOVER;
+        gameState.gameOverType = GameTypes::GameOverType::TFRDRAW;
     }
 
     // check for 50 full moves/100 half moves since a piece capture or a pawn moving aka the 50 move draw.
-    // note: the moveType variable can be overridden to CHECK/GAMEOVER above, so we read attribution
-    // from the moveDelta directly rather than from moveType. wasPromotion counts as a pawn move
-    // even though the post-move endSquare no longer holds a pawn.
-    const auto& endSquarePiece = gameState.boardPosition[move.endSquare.y][move.endSquare.x];
-    const bool wasCapture = moveDelta && moveDelta->capturedPiece;
-    const bool wasPawnMove = moveDelta && (moveDelta->wasPromotion
-                                           || (endSquarePiece && endSquarePiece->type == Piece::Type::PAWN));
-    if (wasCapture || wasPawnMove)
-        gameState.halfMovesSinceLastActiveMove = 0;
-    else {
-        ++gameState.halfMovesSinceLastActiveMove;
-        if (gameState.halfMovesSinceLastActiveMove >= 100) {
-            moveType = GameTypes::MoveType::GAMEOVER;
-            gameState.gameOverType = GameTypes::GameOverType::FIFTYMOVEDRAW;
-        }
+    // movePiece keeps the count up to date, so it only needs reading here
+    if (moveDelta && gameState.halfMovesSinceLastActiveMove >= 100) {
+        moveType = GameTypes::MoveType::GAMEOVER;
+        gameState.gameOverType = GameTypes::GameOverType::FIFTYMOVEDRAW;
     }
-
-    gameState.selectedPieceStartSquare = std::nullopt;
-    gameState.selectedPiece = std::nullopt;
     return moveType;
 }
 
 MoveDelta Game::movePiece(GameState& gameState, const Move& move) const {
-    const auto movePiece = gameState.boardPosition[move.startSquare.y][move.startSquare.x].value();
+    if (gameState.moveColour == Piece::Colour::WHITE)
+        return movePiece<Piece::Colour::WHITE>(gameState, move);
+    return movePiece<Piece::Colour::BLACK>(gameState, move);
+}
+
+template<Piece::Colour Us>
+MoveDelta Game::movePiece(GameState& gameState, const Move& move) const {
+    using Traits = ColourTraits<Us>;
+    using EnemyTraits = ColourTraits<Traits::them>;
+    const auto movePiece = gameState.pieceAt(move.startSquare()).value();
 
     // record everything needed to reverse this move, before any state mutates.
     // capturedPiece is filled in by the enpassant / regular-capture branches below.
@@ -347,48 +342,49 @@ MoveDelta Game::movePiece(GameState& gameState, const Move& move) const {
     moveDelta.previousEnPassantSquare = gameState.enPassantSquare;
     moveDelta.previousMovesSinceEnPassant = gameState.movesSinceEnPassant;
     moveDelta.previousCastlingRights = gameState.castlingRights;
+    moveDelta.previousHalfMovesSinceLastActiveMove = gameState.halfMovesSinceLastActiveMove;
+    moveDelta.previousCheckersBitboard = gameState.checkersBitboard;
     // en passant can override this below
-    moveDelta.capturedPieceSquare = move.endSquare;
+    moveDelta.capturedPieceSquare = move.endSquare();
     moveDelta.previousZobristHash = gameState.zobristHash;
+    moveDelta.previousPawnZobristHash = gameState.pawnZobristHash;
 
     // ---------- en passant ---------------
 
     // XOR out the old enpassant file if it was playable
-    if (isEnPassantPlayable(gameState))
+    if (isEnPassantPlayable<Us>(gameState))
         gameState.zobristHash ^= zobristHashKeys.enPassantFileHash[gameState.enPassantSquare->x];
 
     // check for pawn double push and record the intermediate square it skipped over (enPassantSquare) and the square it is now on (enPassantPawnSquare)
-    if (checkForPawnDoublePush(gameState, move)) {
-        const int forwardStep = movePiece.colour == Piece::Colour::WHITE ? -1 : 1;
-        gameState.enPassantSquare = Vector2Int(move.endSquare.x, move.endSquare.y - forwardStep);
+    if (movePiece.type == Piece::Type::PAWN && move.endSquareIndex() - move.startSquareIndex() == 2 * Traits::forwardStep) {
+        gameState.enPassantSquare = toVector2Int(move.startSquareIndex() + Traits::forwardStep);
         gameState.movesSinceEnPassant = 0;
     }
 
     // capture detection happens BEFORE the moving piece overwrites the destination, so we can
-    // still see what was there. en passant captures live on a different square from move.endSquare,
+    // still see what was there. en passant captures live on a different square from move.endSquare(),
     // so capturedPieceSquare is tracked separately for correct undo.
-    if (checkForEnPassantTake(gameState, move)) {
-        // colour of the pawn to be taken will be the opposite of the current move colour
-        // therefore we can get the forward direction of the other colour and use it to find the square with the pawn to be taken on it
-        const auto enemyForwardStep = gameState.moveColour == Piece::Colour::WHITE ? 1 : -1;
-        const auto capturedSquare = Vector2Int(gameState.enPassantSquare->x, gameState.enPassantSquare->y + enemyForwardStep);
-        moveDelta.capturedPiece = gameState.boardPosition[capturedSquare.y][capturedSquare.x];
+    if (move.flag() == Move::Flag::ENPASSANT) {
+        // the pawn being taken is one step behind the en passant square, as seen by the side making the capture
+        const auto capturedSquare = toVector2Int(toSquareIndex(*gameState.enPassantSquare) - Traits::forwardStep);
+        moveDelta.capturedPiece = gameState.pieceAt(capturedSquare);
         moveDelta.capturedPieceSquare = capturedSquare;
-        gameState.boardPosition[capturedSquare.y][capturedSquare.x] = std::nullopt;
+        gameState.removePiece(capturedSquare);
 
-        // XOR out the pawn on the captured square. read the colour from moveDelta.capturedPiece
-        // (already saved above) rather than re-reading boardPosition - the square was just cleared,
-        // so dereferencing the optional there would be UB.
-        gameState.zobristHash ^= zobristHashKeys.boardHash[capturedSquare.y * 8 + capturedSquare.x][static_cast<int>(Piece::Type::PAWN)][moveDelta.capturedPiece->colour == Piece::Colour::WHITE ? 0 : 1];
+        // XOR out the pawn on the captured square, which is always the enemy's
+        gameState.zobristHash ^= zobristHashKeys.boardHash[capturedSquare.y * 8 + capturedSquare.x][static_cast<int>(Piece::Type::PAWN)][Traits::enemyIndex];
+        gameState.pawnZobristHash ^= zobristHashKeys.boardHash[capturedSquare.y * 8 + capturedSquare.x][static_cast<int>(Piece::Type::PAWN)][Traits::enemyIndex];
     }
-    else if (gameState.boardPosition[move.endSquare.y][move.endSquare.x]) {
-        const auto capturedPiece = gameState.boardPosition[move.endSquare.y][move.endSquare.x];
-        // regular capture - the piece on the end square will be overwritten when we place the moving piece there.
-        // capturedPieceSquare is already move.endSquare from the default above.
+    else if (const auto capturedPiece = gameState.pieceAt(move.endSquare())) {
+        // regular capture - the piece is taken off the end square now so the bitboards are clear for the moving piece.
+        // capturedPieceSquare is already move.endSquare() from the default above.
         moveDelta.capturedPiece = capturedPiece;
+        gameState.removePiece(move.endSquare());
 
         // XOR out the piece on the captured square
-        gameState.zobristHash ^= zobristHashKeys.boardHash[move.endSquare.y * 8 + move.endSquare.x][static_cast<int>(capturedPiece->type)][capturedPiece->colour == Piece::Colour::WHITE ? 0 : 1];
+        gameState.zobristHash ^= zobristHashKeys.boardHash[move.endSquare().y * 8 + move.endSquare().x][static_cast<int>(capturedPiece->type)][Traits::enemyIndex];
+        if (capturedPiece->type == Piece::Type::PAWN)
+            gameState.pawnZobristHash ^= zobristHashKeys.boardHash[move.endSquare().y * 8 + move.endSquare().x][static_cast<int>(Piece::Type::PAWN)][Traits::enemyIndex];
     }
 
     // allow one move before enpassant is no longer available
@@ -403,88 +399,45 @@ MoveDelta Game::movePiece(GameState& gameState, const Move& move) const {
 
     // ----------------- castling --------------------
 
-    // check for castle and if so move the rook on the board. checkForCastle returns CastleType::NOCASTLE
-    // when the move isn't a castle, otherwise the specific WHITE/BLACK QUEENSIDE/KINGSIDE variant.
-    if (const auto castleType = checkForCastle(gameState, move); castleType != GameTypes::CastleType::NOCASTLE) {
+    // check for castle and if so move the rook on the board. the king always lands on the c-file when castling queenside
+    // and the g-file when castling kingside, which picks out this side's queenside or kingside castle.
+    if (move.flag() == Move::Flag::CASTLE) {
+        const auto isQueenside = move.endSquare().x == 2;
+        const auto castleType = isQueenside ? Traits::queensideCastle : Traits::kingsideCastle;
         castleRook(gameState, castleType);
         moveDelta.castleType = castleType;
 
-        Vector2Int rookStartSquare{};
-        Vector2Int rookEndSquare{};
-        switch (castleType) {
-        case GameTypes::CastleType::WHITEQUEENSIDE:
-            rookStartSquare = whiteQueensideRookStartSquare;
-            rookEndSquare = whiteQueensideRookEndSquare;
-            break;
-        case GameTypes::CastleType::WHITEKINGSIDE:
-            rookStartSquare = whiteKingsideRookStartSquare;
-            rookEndSquare = whiteKingsideRookEndSquare;
-            break;
-        case GameTypes::CastleType::BLACKQUEENSIDE:
-            rookStartSquare = blackQueensideRookStartSquare;
-            rookEndSquare = blackQueensideRookEndSquare;
-            break;
-        case GameTypes::CastleType::BLACKKINGSIDE:
-            rookStartSquare = blackKingsideRookStartSquare;
-            rookEndSquare = blackKingsideRookEndSquare;
-            break;
-        }
-
-        auto rookColour = 0;
-        if (castleType == GameTypes::CastleType::BLACKQUEENSIDE || castleType == GameTypes::CastleType::BLACKKINGSIDE)
-            rookColour = 1;
-
+        const auto rookStartSquare = isQueenside ? Traits::queensideRookStartSquare : Traits::kingsideRookStartSquare;
+        const auto rookEndSquare = isQueenside ? Traits::queensideRookEndSquare : Traits::kingsideRookEndSquare;
         // XOR out the rook on its start square
-        gameState.zobristHash ^= zobristHashKeys.boardHash[rookStartSquare.y * 8 + rookStartSquare.x][static_cast<int>(Piece::Type::ROOK)][rookColour];
+        gameState.zobristHash ^= zobristHashKeys.boardHash[rookStartSquare][static_cast<int>(Piece::Type::ROOK)][Traits::index];
         // XOR in the rook on its end square
-        gameState.zobristHash ^= zobristHashKeys.boardHash[rookEndSquare.y * 8 + rookEndSquare.x][static_cast<int>(Piece::Type::ROOK)][rookColour];
+        gameState.zobristHash ^= zobristHashKeys.boardHash[rookEndSquare][static_cast<int>(Piece::Type::ROOK)][Traits::index];
     }
 
     // -------------------- update castling rights --------------------
 
-    const auto endSquareHasPiece = gameState.boardPosition[move.endSquare.y][move.endSquare.x];
-
-    struct SideCastlingData {
-        // indices into gameState.castlingRights for this side's queenside and kingside flags.
-        // ordering of castlingRights is {WQ, WK, BQ, BK}.
-        int queensideIndex;
-        int kingsideIndex;
-        Vector2Int queensideRookStartSquare;
-        Vector2Int kingsideRookStartSquare;
-        Piece::Colour pieceColour;
-    };
-
-    constexpr std::array<SideCastlingData, 2> sides = {{
-        {0, 1, whiteQueensideRookStartSquare, whiteKingsideRookStartSquare, Piece::Colour::WHITE},
-        {2, 3, blackQueensideRookStartSquare, blackKingsideRookStartSquare, Piece::Colour::BLACK}
-    }};
-
-    // for both sides of the board (black and white) we check
-    for (const auto& side : sides) {
-        // initial check - no point doing lots of comparisons if that side has no castling rights
-        if (!gameState.castlingRights[side.queensideIndex] && !gameState.castlingRights[side.kingsideIndex])
-            continue;
-
-        // if this side moved its king, or its rook, update the castling rights
-        if (movePiece.colour == side.pieceColour) {
-            if (movePiece.type == Piece::Type::KING) {
-                gameState.castlingRights[side.queensideIndex] = false;
-                gameState.castlingRights[side.kingsideIndex] = false;
-            } else if (movePiece.type == Piece::Type::ROOK) {
-                if (move.startSquare == side.queensideRookStartSquare)
-                    gameState.castlingRights[side.queensideIndex] = false;
-                if (move.startSquare == side.kingsideRookStartSquare)
-                    gameState.castlingRights[side.kingsideIndex] = false;
-            }
+    auto& castlingRights = gameState.castlingRights;
+
+    // moving the king loses both of this side's castles, and moving a rook off its starting square loses that side's castle
+    if (castlingRights[Traits::queensideCastlingIndex] || castlingRights[Traits::kingsideCastlingIndex]) {
+        if (movePiece.type == Piece::Type::KING) {
+            castlingRights[Traits::queensideCastlingIndex] = false;
+            castlingRights[Traits::kingsideCastlingIndex] = false;
+        } else if (movePiece.type == Piece::Type::ROOK) {
+            if (move.startSquareIndex() == Traits::queensideRookStartSquare)
+                castlingRights[Traits::queensideCastlingIndex] = false;
+            if (move.startSquareIndex() == Traits::kingsideRookStartSquare)
+                castlingRights[Traits::kingsideCastlingIndex] = false;
         }
+    }
 
-        // if an enemy piece moved onto a rook start square on this side, the rook was taken (if it wasn't already), update castling rights
-        if (endSquareHasPiece) {
-            if (move.endSquare == side.queensideRookStartSquare)
-                gameState.castlingRights[side.queensideIndex] = false;
-            if (move.endSquare == side.kingsideRookStartSquare)
-                gameState.castlingRights[side.kingsideIndex] = false;
-        }
+    // a capture on one of the enemy's rook starting squares takes the rook (if it wasn't already gone), losing the enemy that castle
+    if (moveDelta.capturedPiece) {
+        if (move.endSquareIndex() == EnemyTraits::queensideRookStartSquare)
+            castlingRights[EnemyTraits::queensideCastlingIndex] = false;
+        if (move.endSquareIndex() == EnemyTraits::kingsideRookStartSquare)
+            castlingRights[EnemyTraits::kingsideCastlingIndex] = false;
     }
 
     // XOR the castling-rights key for any flag that changed during this move. XOR is self-inverse,
@@ -498,37 +451,50 @@ MoveDelta Game::movePiece(GameState& gameState, const Move& move) const {
     // ----------------- move the piece --------------------
 
     // XOR out the moving piece on the start square
-    gameState.zobristHash ^= zobristHashKeys.boardHash[move.startSquare.y * 8 + move.startSquare.x][static_cast<int>(movePiece.type)][movePiece.colour == Piece::Colour::WHITE ? 0 : 1];
+    gameState.zobristHash ^= zobristHashKeys.boardHash[move.startSquare().y * 8 + move.startSquare().x][static_cast<int>(movePiece.type)][Traits::index];
+    // a pawn leaves the pawn structure from its start square, and only rejoins it on the end square if it didn't promote
+    if (movePiece.type == Piece::Type::PAWN) {
+        gameState.pawnZobristHash ^= zobristHashKeys.boardHash[move.startSquare().y * 8 + move.startSquare().x][static_cast<int>(Piece::Type::PAWN)][Traits::index];
+        if (!move.isPromotion())
+            gameState.pawnZobristHash ^= zobristHashKeys.boardHash[move.endSquare().y * 8 + move.endSquare().x][static_cast<int>(Piece::Type::PAWN)][Traits::index];
+    }
 
     // if a pawn is being promoted, place the requested promotion piece on the end square
-    if (checkForPawnPromotionOnNextMove(gameState, move) && move.promotionPieceType) {
-        gameState.boardPosition[move.endSquare.y][move.endSquare.x] = Piece(*move.promotionPieceType, movePiece.colour);
+    if (move.isPromotion()) {
+        const auto promotionPieceType = *move.promotionPieceType();
+        gameState.placePiece(Piece(promotionPieceType, Us), move.endSquare());
         moveDelta.wasPromotion = true;
 
         // XOR in the promoted piece on the end square
-        gameState.zobristHash ^= zobristHashKeys.boardHash[move.endSquare.y * 8 + move.endSquare.x][static_cast<int>(*move.promotionPieceType)][movePiece.colour == Piece::Colour::WHITE ? 0 : 1];
+        gameState.zobristHash ^= zobristHashKeys.boardHash[move.endSquare().y * 8 + move.endSquare().x][static_cast<int>(promotionPieceType)][Traits::index];
     }
-    // otherwise place the move piece on the end square, overwriting/capturing any enemy piece already there
+    // otherwise place the move piece on the end square, any captured piece has already been removed above
     else {
-        gameState.boardPosition[move.endSquare.y][move.endSquare.x] = movePiece;
+        gameState.placePiece(movePiece, move.endSquare());
 
         // XOR in the moving piece on the end square
-        gameState.zobristHash ^= zobristHashKeys.boardHash[move.endSquare.y * 8 + move.endSquare.x][static_cast<int>(movePiece.type)][movePiece.colour == Piece::Colour::WHITE ? 0 : 1];
+        gameState.zobristHash ^= zobristHashKeys.boardHash[move.endSquare().y * 8 + move.endSquare().x][static_cast<int>(movePiece.type)][Traits::index];
     }
 
     // remove the move piece from the start square
-    gameState.boardPosition[move.startSquare.y][move.startSquare.x] = std::nullopt;
+    gameState.removePiece(move.startSquare());
     // toggle move colour
-    gameState.moveColour = gameState.moveColour == Piece::Colour::WHITE ? Piece::Colour::BLACK : Piece::Colour::WHITE;
+    gameState.moveColour = Traits::them;
     // XOR the turn
     gameState.zobristHash ^= zobristHashKeys.turnHash;
     // XOR in the new en passant file if it is playable (must be done after the move colour has changed)
-    if (isEnPassantPlayable(gameState))
+    if (isEnPassantPlayable<Traits::them>(gameState))
         gameState.zobristHash ^= zobristHashKeys.enPassantFileHash[gameState.enPassantSquare->x];
-    // update move counters
+    // update move counters. captures and pawn moves (promotions included) can never be undone, so they restart the fifty move count
     ++gameState.halfMoveCounter;
     if (gameState.halfMoveCounter % 2 == 0)
         ++gameState.fullMoveCounter;
+    if (movePiece.type == Piece::Type::PAWN || moveDelta.capturedPiece)
+        gameState.halfMovesSinceLastActiveMove = 0;
+    else
+        ++gameState.halfMovesSinceLastActiveMove;
+    // find the pieces now giving check to the side to move, so check tests on the new position are a single bitboard test
+    gameState.checkersBitboard = calculateCheckers(gameState);
 
     return moveDelta;
 }
@@ -545,17 +511,17 @@ void Game::undoLastMove(GameState& gameState, const MoveDelta& moveDelta) const
     --gameState.halfMoveCounter;
 
     // restore the piece on the start square. for promotions the piece on endSquare is the promoted piece, so put a pawn back instead of copying.
+    const auto endSquarePiece = *gameState.pieceAt(move.endSquare());
+    // clear the end square, for regular captures the captured-piece restore below will refill it.
+    gameState.removePiece(move.endSquare());
     if (moveDelta.wasPromotion)
-        gameState.boardPosition[move.startSquare.y][move.startSquare.x] = Piece(Piece::Type::PAWN, gameState.moveColour);
+        gameState.placePiece(Piece(Piece::Type::PAWN, gameState.moveColour), move.startSquare());
     else
-        gameState.boardPosition[move.startSquare.y][move.startSquare.x] = gameState.boardPosition[move.endSquare.y][move.endSquare.x];
-
-    // clear the end square, for regular captures the captured-piece restore below will refill it.
-    gameState.boardPosition[move.endSquare.y][move.endSquare.x] = std::nullopt;
+        gameState.placePiece(endSquarePiece, move.startSquare());
 
     // restore captured piece. for regular captures capturedPieceSquare == endSquare, for en passant it's one rank away.
     if (moveDelta.capturedPiece)
-        gameState.boardPosition[moveDelta.capturedPieceSquare.y][moveDelta.capturedPieceSquare.x] = moveDelta.capturedPiece;
+        gameState.placePiece(*moveDelta.capturedPiece, moveDelta.capturedPieceSquare);
 
     // undo the castling rook move - castleRook moved the rook from its corner to its castle-end square; reverse it.
     if (moveDelta.castleType != GameTypes::CastleType::NOCASTLE) {
@@ -569,15 +535,19 @@ void Game::undoLastMove(GameState& gameState, const MoveDelta& moveDelta) const
         }};
         const auto rookArrayIndex = static_cast<int>(moveDelta.castleType) - 1;
         const auto& [rookStart, rookEnd] = castleRookEndpoints[rookArrayIndex];
-        gameState.boardPosition[rookStart.y][rookStart.x] = gameState.boardPosition[rookEnd.y][rookEnd.x];
-        gameState.boardPosition[rookEnd.y][rookEnd.x] = std::nullopt;
+        const auto rook = *gameState.pieceAt(rookEnd);
+        gameState.removePiece(rookEnd);
+        gameState.placePiece(rook, rookStart);
     }
 
     // restore enpassant and castling rights states.
     gameState.enPassantSquare = moveDelta.previousEnPassantSquare;
     gameState.movesSinceEnPassant = moveDelta.previousMovesSinceEnPassant;
     gameState.castlingRights = moveDelta.previousCastlingRights;
+    gameState.halfMovesSinceLastActiveMove = moveDelta.previousHalfMovesSinceLastActiveMove;
+    gameState.checkersBitboard = moveDelta.previousCheckersBitboard;
     gameState.zobristHash = moveDelta.previousZobristHash;
+    gameState.pawnZobristHash = moveDelta.previousPawnZobristHash;
 }
 
 void Game::castleRook(GameState& gameState, const GameTypes::CastleType castleType) const {
@@ -600,31 +570,51 @@ void Game::castleRook(GameState& gameState, const GameTypes::CastleType castleTy
     // NOCASTLE is the caller's responsibility to filter out before calling castleRook.
     const auto& rookData = rookMoves[static_cast<int>(castleType) - 1];
 
-    gameState.boardPosition[rookData.startSquare.y][rookData.startSquare.x] = std::nullopt;
-    gameState.boardPosition[rookData.endSquare.y][rookData.endSquare.x] = Piece(Piece::Type::ROOK, rookData.rookColour);
+    gameState.removePiece(rookData.startSquare);
+    gameState.placePiece(Piece(Piece::Type::ROOK, rookData.rookColour), rookData.endSquare);
+}
+
+Move Game::createMove(const GameState& gameState, const Vector2Int startSquare, const Vector2Int endSquare, const std::optional<Piece::Type> promotionPieceType) const {
+    const auto bareMove = Move(startSquare, endSquare);
+    const auto movePiece = gameState.pieceAt(startSquare);
+    if (!movePiece)
+        return bareMove;
+
+    // a pawn reaching the last rank always promotes, defaulting to a queen if no choice was given
+    if (checkForPawnPromotionOnNextMove(gameState, bareMove))
+        return {toSquareIndex(startSquare), toSquareIndex(endSquare), Move::Flag::PROMOTION, promotionPieceType.value_or(Piece::Type::QUEEN)};
+    if (checkForEnPassantTake(gameState, bareMove))
+        return {toSquareIndex(startSquare), toSquareIndex(endSquare), Move::Flag::ENPASSANT};
+    if (movePiece->type == Piece::Type::KING && checkForCastle(gameState, bareMove) != GameTypes::CastleType::NOCASTLE)
+        return {toSquareIndex(startSquare), toSquareIndex(endSquare), Move::Flag::CASTLE};
+    return bareMove;
 }
 
 bool Game::isMoveValid(const GameState& gameState, const Move& move) const {
     // make sure start square contains a piece
-    if (!gameState.boardPosition[move.startSquare.y][move.startSquare.x])
+    if (!gameState.pieceAt(move.startSquare()))
+        return false;
+    const auto movePiece = gameState.pieceAt(move.startSquare()).value();
+    // and that the piece belongs to the side to move. moves from the search's tables are checked here before being
+    // played without generating the full move list, and those can come from a position where the other side was to move
+    if (movePiece.colour != gameState.moveColour)
         return false;
-    const auto movePiece = gameState.boardPosition[move.startSquare.y][move.startSquare.x].value();
 
     // check start and end square are in different locations and check the end position is on the board
-    if (move.startSquare == move.endSquare || move.endSquare.x < 0 || move.endSquare.x > 7 || move.endSquare.y < 0 || move.endSquare.y > 7)
+    if (move.startSquare() == move.endSquare() || move.endSquare().x < 0 || move.endSquare().x > 7 || move.endSquare().y < 0 || move.endSquare().y > 7)
         return false;
 
     // check end square is either empty or contains an enemy piece.
     // kings are never capturable in chess; mate must be represented by "no legal replies while in check",
     // not by allowing a move onto the enemy king's square.
-    if (gameState.boardPosition[move.endSquare.y][move.endSquare.x]) {
-        if (gameState.boardPosition[move.endSquare.y][move.endSquare.x]->type == Piece::Type::KING)
+    if (const auto endSquarePiece = gameState.pieceAt(move.endSquare())) {
+        if (endSquarePiece->type == Piece::Type::KING)
             return false;
-        if (gameState.boardPosition[move.endSquare.y][move.endSquare.x]->colour == movePiece.colour)
+        if (endSquarePiece->colour == movePiece.colour)
             return false;
     }
 
-    const Vector2Int moveVector = {move.endSquare.x - move.startSquare.x, move.endSquare.y - move.startSquare.y};
+    const Vector2Int moveVector = {move.endSquare().x - move.startSquare().x, move.endSquare().y - move.startSquare().y};
     const auto absMoveVector = Vector2Int(std::abs(moveVector.x), std::abs(moveVector.y));
 
     switch (movePiece.type) {
@@ -648,24 +638,24 @@ bool Game::isMoveLegal(const GameState& gameState, const Move& move) const {
     if (!isMoveValid(gameState, move))
         return false;
 
-    // simulate the board position if the move was to be made
-    auto simulatedGameState = gameState;
-    movePiece(simulatedGameState, move);
+    // movePiece trusts the flag bits, so a move whose flags don't match what the board says it is can't be played
+    if (move != createMove(gameState, move.startSquare(), move.endSquare(), move.promotionPieceType()))
+        return false;
 
     // disallow moves that would leave the king in check
-    if (isKingInCheck(simulatedGameState, gameState.moveColour))
+    if (wouldMoveLeaveKingInCheck(gameState, move))
         return false;
 
     // don't allow castling if the king is in check, or if it would move the king through squares under attack
     if (checkForCastle(gameState, move) != GameTypes::CastleType::NOCASTLE) {
         // get direction of move
         Vector2Int stepVector = {1, 0};
-        if (move.endSquare.x - move.startSquare.x < 0)
+        if (move.endSquare().x - move.startSquare().x < 0)
             stepVector.x = -1;
 
         // check none of the squares in between the startSquare (inclusive) and the endSquare are under attack
-        Vector2Int currentSquare = move.startSquare;
-        while (currentSquare != move.endSquare) {
+        Vector2Int currentSquare = move.startSquare();
+        while (currentSquare != move.endSquare()) {
             if (isSquareUnderAttack(gameState, currentSquare, gameState.moveColour == Piece::Colour::WHITE ? Piece::Colour::BLACK : Piece::Colour::WHITE, std::nullopt))
                 return false;
             currentSquare += stepVector;
@@ -675,7 +665,7 @@ bool Game::isMoveLegal(const GameState& gameState, const Move& move) const {
 }
 
 bool Game::isMovePathClearForSliders(const GameState& gameState, const Move& move) const {
-    const Vector2Int moveVector = {move.endSquare.x - move.startSquare.x, move.endSquare.y - move.startSquare.y};
+    const Vector2Int moveVector = {move.endSquare().x - move.startSquare().x, move.endSquare().y - move.startSquare().y};
 
     // check to make sure the move makes geometric sense for sliding pieces
     // i.e. is the end piece legally reachable from the start piece horizontally, vertically or diagonally
@@ -696,9 +686,9 @@ bool Game::isMovePathClearForSliders(const GameState& gameState, const Move& mov
         stepVector.y -= 1;
 
     // the step vector is then repeatedly added on from the start square until we reach the end square, if no piece is found while traversing then the move path is clear
-    Vector2Int currentSquare = move.startSquare + stepVector;
-    while (currentSquare != move.endSquare) {
-        if (gameState.boardPosition[currentSquare.y][currentSquare.x])
+    Vector2Int currentSquare = move.startSquare() + stepVector;
+    while (currentSquare != move.endSquare()) {
+        if (gameState.pieceAt(currentSquare))
             return false;
         currentSquare += stepVector;
     }
@@ -706,7 +696,7 @@ bool Game::isMovePathClearForSliders(const GameState& gameState, const Move& mov
 }
 
 bool Game::isMoveValidForKing(const GameState& gameState, const Move& move) const {
-    const Vector2Int moveVector = {move.endSquare.x - move.startSquare.x, move.endSquare.y - move.startSquare.y};
+    const Vector2Int moveVector = {move.endSquare().x - move.startSquare().x, move.endSquare().y - move.startSquare().y};
 
     // normal king move
     if (const auto absMoveVector = Vector2Int(std::abs(moveVector.x), std::abs(moveVector.y)); std::max(absMoveVector.x, absMoveVector.y) == 1)
@@ -723,7 +713,7 @@ GameTypes::CastleType Game::checkForCastle(const GameState& gameState, const Mov
     // this short-circuit also means every other check below is per-side rather than per-piece.
     const bool isWhite = gameState.moveColour == Piece::Colour::WHITE;
     const Vector2Int kingStartSquare = isWhite ? whiteKingStartSquare : blackKingStartSquare;
-    if (move.startSquare != kingStartSquare)
+    if (move.startSquare() != kingStartSquare)
         return CastleType::NOCASTLE;
 
     // group everything the per-castle check needs into one struct so the loop body stays uniform.
@@ -764,12 +754,12 @@ GameTypes::CastleType Game::checkForCastle(const GameState& gameState, const Mov
 
     for (const auto& option : castleOptions) {
         // 1. the side must still have castling rights for this castle, and the king must be heading to the right square.
-        if (!gameState.castlingRights[option.rightsIndex] || move.endSquare != option.kingTarget)
+        if (!gameState.castlingRights[option.rightsIndex] || move.endSquare() != option.kingTarget)
             continue;
 
         // 2. the rook must still be sitting on its starting square. updateCastlingRights would normally clear
         //    the rights when a rook moves or is captured, but the board check is a safety net.
-        const auto& rookSquare = gameState.boardPosition[option.rookStartSquare.y][option.rookStartSquare.x];
+        const auto rookSquare = gameState.pieceAt(option.rookStartSquare);
         if (!rookSquare || rookSquare->type != Piece::Type::ROOK || rookSquare->colour != rookColour)
             continue;
 
@@ -777,7 +767,7 @@ GameTypes::CastleType Game::checkForCastle(const GameState& gameState, const Mov
         bool pathClear = true;
         for (int i = 0; i < option.emptySquaresCount; ++i) {
             const auto& square = option.emptySquares[i];
-            if (gameState.boardPosition[square.y][square.x]) {
+            if (gameState.pieceAt(square)) {
                 pathClear = false;
                 break;
             }
@@ -793,13 +783,13 @@ GameTypes::CastleType Game::checkForCastle(const GameState& gameState, const Mov
 }
 
 bool Game::isMoveValidForPawn(const GameState& gameState, const Move& move) const {
-    if (!gameState.boardPosition[move.startSquare.y][move.startSquare.x])
+    if (!gameState.pieceAt(move.startSquare()))
         return false;
     // make sure the end square is on the board
-    if (move.endSquare.x < 0 || move.endSquare.x > 7 || move.endSquare.y < 0 || move.endSquare.y > 7)
+    if (move.endSquare().x < 0 || move.endSquare().x > 7 || move.endSquare().y < 0 || move.endSquare().y > 7)
         return false;
-    const auto movePiece = gameState.boardPosition[move.startSquare.y][move.startSquare.x].value();
-    const Vector2Int moveVector = {move.endSquare.x - move.startSquare.x, move.endSquare.y - move.startSquare.y};
+    const auto movePiece = gameState.pieceAt(move.startSquare()).value();
+    const Vector2Int moveVector = {move.endSquare().x - move.startSquare().x, move.endSquare().y - move.startSquare().y};
 
     if (moveVector.y == 0 || std::abs(moveVector.x) > 1 || std::abs(moveVector.y) > 2)
         return false;
@@ -813,7 +803,7 @@ bool Game::isMoveValidForPawn(const GameState& gameState, const Move& move) cons
         forwardStep = -1;
 
     // already checked for friendly pieces on end square when doing universal checks so if there is a piece it has to be an enemy
-    if (gameState.boardPosition[move.endSquare.y][move.endSquare.x])
+    if (gameState.pieceAt(move.endSquare()))
         enemyOnEndSquare = true;
 
     // single push forward
@@ -827,7 +817,7 @@ bool Game::isMoveValidForPawn(const GameState& gameState, const Move& move) cons
 
     // taking an enemy piece normally
     // requires there to be an enemy piece on the end square, 1 unit of horizontal movement and 1 forward step of vertical movement
-    if (gameState.boardPosition[move.endSquare.y][move.endSquare.x]) {
+    if (gameState.pieceAt(move.endSquare())) {
         if (std::abs(moveVector.x) == 1 && moveVector.y == forwardStep)
             return true;
     }
@@ -839,13 +829,13 @@ bool Game::isMoveValidForPawn(const GameState& gameState, const Move& move) cons
 }
 
 bool Game::checkForPawnDoublePush(const GameState& gameState, const Move& move) const {
-    if (!gameState.boardPosition[move.startSquare.y][move.startSquare.x])
+    if (!gameState.pieceAt(move.startSquare()))
         return false;
-    const auto movePiece = *gameState.boardPosition[move.startSquare.y][move.startSquare.x];
+    const auto movePiece = *gameState.pieceAt(move.startSquare());
     if (movePiece.type != Piece::Type::PAWN || movePiece.colour != gameState.moveColour)
         return false;
 
-    const Vector2Int moveVector = {move.endSquare.x - move.startSquare.x, move.endSquare.y - move.startSquare.y};
+    const Vector2Int moveVector = {move.endSquare().x - move.startSquare().x, move.endSquare().y - move.startSquare().y};
     int forwardStep = 1;
     int startingRow = 1;
     bool enemyOnEndSquare = false;
@@ -853,148 +843,147 @@ bool Game::checkForPawnDoublePush(const GameState& gameState, const Move& move)
         forwardStep = -1;
         startingRow = 6;
     }
-    if (gameState.boardPosition[move.endSquare.y][move.endSquare.x])
+    if (gameState.pieceAt(move.endSquare()))
         enemyOnEndSquare = true;
 
     // double push forward
     // requires no horizontal movement, 2 forward steps of vertical movement, pawn must be on the starting row, there must not be an enemy on the destination square
     // and there must not a piece on the intermediate square between the start and end square
-    return moveVector.x == 0 && moveVector.y == (forwardStep * 2) && move.startSquare.y == startingRow && !enemyOnEndSquare && isMovePathClearForSliders(gameState, move);
+    return moveVector.x == 0 && moveVector.y == (forwardStep * 2) && move.startSquare().y == startingRow && !enemyOnEndSquare && isMovePathClearForSliders(gameState, move);
 }
 
 bool Game::checkForEnPassantTake(const GameState& gameState, const Move& move) const {
     if (!gameState.enPassantSquare)
         return false;
-    if (!gameState.boardPosition[move.startSquare.y][move.startSquare.x])
+    if (!gameState.pieceAt(move.startSquare()))
         return false;
-    const auto movePiece = *gameState.boardPosition[move.startSquare.y][move.startSquare.x];
+    const auto movePiece = *gameState.pieceAt(move.startSquare());
     if (movePiece.type != Piece::Type::PAWN || movePiece.colour != gameState.moveColour)
         return false;
 
     const auto enemyForwardStep = gameState.moveColour == Piece::Colour::WHITE ? 1 : -1;
     const auto enPassantPawnSquare = Vector2Int(gameState.enPassantSquare.value().x, gameState.enPassantSquare.value().y + enemyForwardStep);
     // check that the pawn is trying to move to the enpassant square and then check that the pawn is directly next to the enpassant pawn (the pawn that just moved 2 spaces last turn)
-    if (move.endSquare == gameState.enPassantSquare && std::abs(move.startSquare.x - enPassantPawnSquare.x) == 1 && move.startSquare.y == enPassantPawnSquare.y) {
+    if (move.endSquare() == gameState.enPassantSquare && std::abs(move.startSquare().x - enPassantPawnSquare.x) == 1 && move.startSquare().y == enPassantPawnSquare.y) {
         // check to make sure the enpassant pawn square does have a piece on it
-        if (gameState.boardPosition[enPassantPawnSquare.y][enPassantPawnSquare.x]) {
+        if (const auto enPassantPawn = gameState.pieceAt(enPassantPawnSquare)) {
             // if that piece is a pawn of the opposite colour then an enpassant take can be made
-            if (gameState.boardPosition[enPassantPawnSquare.y][enPassantPawnSquare.x]->type == Piece::Type::PAWN && gameState.boardPosition[enPassantPawnSquare.y][enPassantPawnSquare.x]->colour != gameState.moveColour)
+            if (enPassantPawn->type == Piece::Type::PAWN && enPassantPawn->colour != gameState.moveColour)
                 return true;
         }
     }
     return false;
 }
 
-bool Game::isSquareUnderAttack(const GameState& gameState, const Vector2Int square, const Piece::Colour enemyColour, const std::optional<Vector2Int> ignoredSquare) const {
-    // -------------------- check for pawn attack --------------------
-
-    if (isSquareUnderAttackByPawn(gameState, square, enemyColour))
-        return true;
-
-    // -------------------- check for knight attack --------------------
+Bitboard Game::getAttackersToSquare(const GameState& gameState, const int square, const Bitboard occupied) const {
+    const auto& whitePieces = gameState.pieceBitboards[0];
+    const auto& blackPieces = gameState.pieceBitboards[1];
+    const auto& attackTables = Bitboards::attackTables;
+
+    // every attack pattern is symmetric, so a piece attacks the square exactly when the same piece standing on the square would attack it back.
+    // the exception is pawns, which attack in one direction only, so a white pawn attacks the square if a black pawn on the square would attack it
+    const Bitboard rooksAndQueens = whitePieces[static_cast<int>(Piece::Type::ROOK)] | whitePieces[static_cast<int>(Piece::Type::QUEEN)]
+                                  | blackPieces[static_cast<int>(Piece::Type::ROOK)] | blackPieces[static_cast<int>(Piece::Type::QUEEN)];
+    const Bitboard bishopsAndQueens = whitePieces[static_cast<int>(Piece::Type::BISHOP)] | whitePieces[static_cast<int>(Piece::Type::QUEEN)]
+                                    | blackPieces[static_cast<int>(Piece::Type::BISHOP)] | blackPieces[static_cast<int>(Piece::Type::QUEEN)];
+
+    return (attackTables.pawnAttacks[1][square] & whitePieces[static_cast<int>(Piece::Type::PAWN)])
+         | (attackTables.pawnAttacks[0][square] & blackPieces[static_cast<int>(Piece::Type::PAWN)])
+         | (attackTables.knightAttacks[square] & (whitePieces[static_cast<int>(Piece::Type::KNIGHT)] | blackPieces[static_cast<int>(Piece::Type::KNIGHT)]))
+         | (attackTables.kingAttacks[square] & (whitePieces[static_cast<int>(Piece::Type::KING)] | blackPieces[static_cast<int>(Piece::Type::KING)]))
+         | (Bitboards::rookAttacks(square, occupied) & rooksAndQueens)
+         | (Bitboards::bishopAttacks(square, occupied) & bishopsAndQueens);
+}
 
-    for (const auto& vector : knightVectors) {
-        const auto& possibleKnightSquare = square + vector;
-        // make sure the square being checked is on the board
-        if (possibleKnightSquare.x < 0 || possibleKnightSquare.x > 7 || possibleKnightSquare.y < 0 || possibleKnightSquare.y > 7)
-            continue;
+Bitboard Game::getAttackedSquares(const GameState& gameState, const Piece::Colour attackingColour, const Bitboard occupied) const {
+    const auto& pieces = gameState.pieceBitboards[static_cast<int>(attackingColour)];
+    const auto& attackTables = Bitboards::attackTables;
+
+    auto attackedSquares = Bitboards::allPawnAttacks(pieces[static_cast<int>(Piece::Type::PAWN)], static_cast<int>(attackingColour));
+    auto kings = pieces[static_cast<int>(Piece::Type::KING)];
+    while (kings)
+        attackedSquares |= attackTables.kingAttacks[Bitboards::popLeastSignificantSquare(kings)];
+    auto knights = pieces[static_cast<int>(Piece::Type::KNIGHT)];
+    while (knights)
+        attackedSquares |= attackTables.knightAttacks[Bitboards::popLeastSignificantSquare(knights)];
+    auto diagonalSliders = pieces[static_cast<int>(Piece::Type::BISHOP)] | pieces[static_cast<int>(Piece::Type::QUEEN)];
+    while (diagonalSliders)
+        attackedSquares |= Bitboards::bishopAttacks(Bitboards::popLeastSignificantSquare(diagonalSliders), occupied);
+    auto orthogonalSliders = pieces[static_cast<int>(Piece::Type::ROOK)] | pieces[static_cast<int>(Piece::Type::QUEEN)];
+    while (orthogonalSliders)
+        attackedSquares |= Bitboards::rookAttacks(Bitboards::popLeastSignificantSquare(orthogonalSliders), occupied);
+    return attackedSquares;
+}
 
-        // if square has a piece on it
-        if (gameState.boardPosition[possibleKnightSquare.y][possibleKnightSquare.x]) {
-            // if that piece is an enemy knight
-            if (const auto piece = *gameState.boardPosition[possibleKnightSquare.y][possibleKnightSquare.x]; piece.colour == enemyColour && piece.type == Piece::Type::KNIGHT)
-                return true;
-        }
-    }
+Bitboard Game::calculateCheckers(const GameState& gameState) const {
+    const auto friendlyColour = gameState.moveColour;
+    const auto enemyColour = friendlyColour == Piece::Colour::WHITE ? Piece::Colour::BLACK : Piece::Colour::WHITE;
+    if (gameState.pieceCounts[static_cast<int>(friendlyColour)][static_cast<int>(Piece::Type::KING)] == 0)
+        return 0;
+    return getAttackersToSquare(gameState, gameState.kingSquares[static_cast<int>(friendlyColour)], gameState.occupiedBitboard) & gameState.colourBitboards[static_cast<int>(enemyColour)];
+}
 
-    // -------------------- check for king attack --------------------
+bool Game::isSquareUnderAttack(const GameState& gameState, const Vector2Int square, const Piece::Colour enemyColour, const std::optional<Vector2Int> ignoredSquare) const {
+    // the ignored square is treated as empty so sliders can see through it. this is used to discount the king's own square
+    // when checking whether a destination square would be attacked after the king moves.
+    auto occupied = gameState.occupiedBitboard;
+    if (ignoredSquare)
+        occupied &= ~Bitboards::squareBitboard(toSquareIndex(*ignoredSquare));
 
-    for (const auto& direction : pieceDirections) {
-        const auto& possibleKingSquare = square + direction;
-        // make sure the square being checked is on the board
-        if (possibleKingSquare.x < 0 || possibleKingSquare.x > 7 || possibleKingSquare.y < 0 || possibleKingSquare.y > 7)
-            continue;
+    return getAttackersToSquare(gameState, toSquareIndex(square), occupied) & gameState.colourBitboards[static_cast<int>(enemyColour)];
+}
 
-        // if square has a piece on it
-        if (gameState.boardPosition[possibleKingSquare.y][possibleKingSquare.x]) {
-            // if that piece is an enemy king
-            if (const auto piece = *gameState.boardPosition[possibleKingSquare.y][possibleKingSquare.x]; piece.colour == enemyColour && piece.type == Piece::Type::KING)
-                return true;
-        }
-    }
+bool Game::isKingInCheck(const GameState& gameState, const Piece::Colour kingColour) const {
+    // the side to move's checkers are already known
+    if (kingColour == gameState.moveColour)
+        return gameState.checkersBitboard != 0;
+    if (gameState.pieceCounts[static_cast<int>(kingColour)][static_cast<int>(Piece::Type::KING)] == 0)
+        return false;
 
-    // -------------------- check for sliders attack --------------------
-
-    for (const auto& direction : pieceDirections) {
-        auto currentSquare = square + direction;
-        while (currentSquare.x >= 0 && currentSquare.x < 8 && currentSquare.y >= 0 && currentSquare.y < 8) {
-            // a piece on the current square blocks further attackers along this ray, UNLESS it's the
-            // ignored square - in which case we walk past it as if empty. this is used to discount the
-            // king's own square when checking whether a destination square would be attacked after the king moves.
-            // important: the "skip past ignored" path must fall through to currentSquare += direction below;
-            // a continue here would loop forever because the same square would keep matching "has a piece".
-            if (gameState.boardPosition[currentSquare.y][currentSquare.x] && currentSquare != ignoredSquare) {
-                if (const auto piece = *gameState.boardPosition[currentSquare.y][currentSquare.x]; piece.colour == enemyColour) {
-                    if (piece.type == Piece::Type::QUEEN)
-                        return true;
-                    // find out if we travelled straight or diagonally to get here, the calculation will result in 1 == straight movement, 2 = diagonal movement
-                    const bool movedStraight = std::abs(direction.x) + std::abs(direction.y) == 1;
-                    if (piece.type == Piece::Type::ROOK && movedStraight)
-                        return true;
-                    if (piece.type == Piece::Type::BISHOP && !movedStraight)
-                        return true;
-                }
-                break;
-            }
-            currentSquare += direction;
-        }
-    }
-    return false;
+    // check whether the king is currently under attack
+    const auto enemyColour = kingColour == Piece::Colour::WHITE ? Piece::Colour::BLACK : Piece::Colour::WHITE;
+    return isSquareUnderAttack(gameState, toVector2Int(gameState.kingSquares[static_cast<int>(kingColour)]), enemyColour, std::nullopt);
 }
 
-bool Game::isSquareUnderAttackByPawn(const GameState& gameState, const Vector2Int square, const Piece::Colour enemyColour) const {
-    // get forward step of friendly colour
-    int forwardStep = 1;
-    if (enemyColour == Piece::Colour::BLACK)
-        forwardStep = -1;
-
-    // check for enemy pawns on the two diagonally forward squares
-    if (const auto squareOne = Vector2Int(square.x + 1, square.y + forwardStep); squareOne.x < 8 && squareOne.y >= 0 && squareOne.y < 8) {
-        if (gameState.boardPosition[squareOne.y][squareOne.x]) {
-            if (gameState.boardPosition[squareOne.y][squareOne.x]->colour == enemyColour && gameState.boardPosition[squareOne.y][squareOne.x]->type == Piece::Type::PAWN)
-                return true;
-        }
-    }
-    if (const auto squareTwo = Vector2Int(square.x - 1, square.y + forwardStep); squareTwo.x >= 0 && squareTwo.y >= 0 && squareTwo.y < 8) {
-        if (gameState.boardPosition[squareTwo.y][squareTwo.x]) {
-            if (gameState.boardPosition[squareTwo.y][squareTwo.x]->colour == enemyColour && gameState.boardPosition[squareTwo.y][squareTwo.x]->type == Piece::Type::PAWN)
-                return true;
-        }
+int Game::countRepetitions(const GameState& gameState, const std::vector<uint64_t>& zobristHashHistory) const {
+    // a position can only repeat with the same side to move, so every second hash is compared, starting two half moves back.
+    // nothing from before the last capture or pawn move can match, so the scan stops there
+    const auto historySize = static_cast<int>(zobristHashHistory.size());
+    const auto oldestIndex = std::max(historySize - gameState.halfMovesSinceLastActiveMove, 0);
+    auto repetitions = 0;
+    for (auto i = historySize - 2; i >= oldestIndex; i -= 2) {
+        if (zobristHashHistory[i] == gameState.zobristHash)
+            ++repetitions;
     }
-    return false;
+    return repetitions;
 }
 
-bool Game::isKingInCheck(const GameState& gameState, const Piece::Colour kingColour) const {
-    // find the king
-    for (auto rank = 0; rank < 8; ++rank) {
-        for (auto file = 0; file < 8; ++file) {
-            if (gameState.boardPosition[rank][file]) {
-                if (gameState.boardPosition[rank][file]->colour == kingColour && gameState.boardPosition[rank][file]->type == Piece::Type::KING) {
-                    // check whether the king is currently under attack
-                    const auto enemyColour = kingColour == Piece::Colour::WHITE ? Piece::Colour::BLACK : Piece::Colour::WHITE;
-                    return isSquareUnderAttack(gameState, Vector2Int(file, rank), enemyColour, std::nullopt);
-                }
-            }
-        }
-    }
-    return false;
+bool Game::wouldMoveLeaveKingInCheck(const GameState& gameState, const Move& move) const {
+    const auto friendlyColour = gameState.moveColour;
+    const auto enemyColour = friendlyColour == Piece::Colour::WHITE ? Piece::Colour::BLACK : Piece::Colour::WHITE;
+    if (gameState.pieceCounts[static_cast<int>(friendlyColour)][static_cast<int>(Piece::Type::KING)] == 0)
+        return false;
+
+    // rather than playing the move on a copy of the game state, work out which squares it empties and fills and look
+    // for attackers on the king's square with that occupancy. the moving piece leaves its start square, and anything on
+    // the end square or the pawn taken en passant is captured, so none of them can attack the king afterwards
+    const auto startSquare = move.startSquareIndex();
+    const auto endSquare = move.endSquareIndex();
+    auto removedPieces = Bitboards::squareBitboard(startSquare) | Bitboards::squareBitboard(endSquare);
+    if (move.flag() == Move::Flag::ENPASSANT)
+        removedPieces |= Bitboards::squareBitboard(toSquareIndex(Vector2Int(move.endSquare().x, move.startSquare().y)));
+    const auto occupied = (gameState.occupiedBitboard & ~removedPieces) | Bitboards::squareBitboard(endSquare);
+
+    // the castling rook is ignored, as it only moves onto squares the king has already been checked to pass through safely
+    const auto kingSquare = startSquare == gameState.kingSquares[static_cast<int>(friendlyColour)] ? endSquare : gameState.kingSquares[static_cast<int>(friendlyColour)];
+    return getAttackersToSquare(gameState, kingSquare, occupied) & gameState.colourBitboards[static_cast<int>(enemyColour)] & ~removedPieces;
 }
 
 bool Game::checkForPawnPromotionOnLastMove(const GameState& gameState) const {
     for (auto rank = 0; rank < 8; rank += 7) {
         for (auto file = 0; file < 8; ++file) {
-            if (gameState.boardPosition[rank][file]) {
-                if (gameState.boardPosition[rank][file]->type == Piece::Type::PAWN) {
+            if (const auto piece = gameState.pieceAt(Vector2Int(file, rank))) {
+                if (piece->type == Piece::Type::PAWN) {
                     return true;
                 }
             }
@@ -1004,345 +993,232 @@ bool Game::checkForPawnPromotionOnLastMove(const GameState& gameState) const {
 }
 
 bool Game::checkForPawnPromotionOnNextMove(const GameState& gameState, const Move& move) const {
-    const auto& piece = gameState.boardPosition[move.startSquare.y][move.startSquare.x];
+    const auto piece = gameState.pieceAt(move.startSquare());
     if (piece->type != Piece::Type::PAWN)
         return false;
     if (piece->colour == Piece::Colour::WHITE)
-        return move.endSquare.y == 0;
-    return move.endSquare.y == 7;
+        return move.endSquare().y == 0;
+    return move.endSquare().y == 7;
 }
 
-struct PinInfo
-{
-    Vector2Int pinSquare;
-    Vector2Int pinDirection;
-
-    PinInfo(const Vector2Int pinSquare, const Vector2Int pinDirection) : pinSquare(pinSquare), pinDirection(pinDirection) {}
-};
-
-struct CheckerInfo
-{
-    int numCheckers = 0;
-    std::optional<Vector2Int> checkerSquare;
-    std::array<bool, 64> checkRay{};
-};
+void Game::generateAllLegalMoves(const GameState& gameState, MoveList& moves, const GameTypes::MoveGenerationType generationType) const {
+    if (gameState.moveColour == Piece::Colour::WHITE)
+        generateLegalMoves<Piece::Colour::WHITE, false>(gameState, &moves, generationType);
+    else
+        generateLegalMoves<Piece::Colour::BLACK, false>(gameState, &moves, generationType);
+}
 
-std::vector<Move> Game::generateAllLegalMoves(const GameState& gameState, bool capturesOnly) const {
-    Vector2Int kingSquare{};
-    std::array<std::optional<PinInfo>, 8> pins;
+size_t Game::countLegalMoves(const GameState& gameState) const {
+    if (gameState.moveColour == Piece::Colour::WHITE)
+        return generateLegalMoves<Piece::Colour::WHITE, true>(gameState, nullptr, GameTypes::MoveGenerationType::ALL);
+    return generateLegalMoves<Piece::Colour::BLACK, true>(gameState, nullptr, GameTypes::MoveGenerationType::ALL);
+}
 
-    // find the king square
-    for (auto rank = 0; rank < 8; ++rank) {
-        for (auto file = 0; file < 8; ++file) {
-            if (gameState.boardPosition[rank][file] && gameState.boardPosition[rank][file]->type == Piece::Type::KING && gameState.boardPosition[rank][file]->colour == gameState.moveColour)
-                kingSquare = Vector2Int(file, rank);
-        }
+template<Piece::Colour Us, bool countOnly>
+size_t Game::generateLegalMoves(const GameState& gameState, MoveList* moves, const GameTypes::MoveGenerationType generationType) const {
+    using Traits = ColourTraits<Us>;
+    const auto& attackTables = Bitboards::attackTables;
+    const auto& friendlyPieces = gameState.pieceBitboards[Traits::index];
+    const auto& enemyPieces = gameState.pieceBitboards[Traits::enemyIndex];
+    const auto occupied = gameState.occupiedBitboard;
+
+    // a board without a king of the side to move (set up before any position, or from a fen missing one) still gets the
+    // other pieces' moves, there is just no king to move, pin pieces to or be in check
+    const auto king = friendlyPieces[static_cast<int>(Piece::Type::KING)];
+    const auto kingSquare = Bitboards::leastSignificantSquare(king);
+
+    // find all the pinned pieces. every enemy slider that would attack the king on an empty board is a potential pinner,
+    // and it pins a piece if exactly one piece stands between it and the king and that piece is friendly
+    Bitboard pinnedPieces = 0;
+    Bitboard pinners = 0;
+    if (king) {
+        pinners = (Bitboards::rookAttacks(kingSquare, 0) & (enemyPieces[static_cast<int>(Piece::Type::ROOK)] | enemyPieces[static_cast<int>(Piece::Type::QUEEN)]))
+                | (Bitboards::bishopAttacks(kingSquare, 0) & (enemyPieces[static_cast<int>(Piece::Type::BISHOP)] | enemyPieces[static_cast<int>(Piece::Type::QUEEN)]));
     }
-
-    // find all the pinned pieces by raycasting from the king square
-    for (auto i = 0; i < 8; ++i) {
-        const auto direction = pieceDirections[i];
-        auto currentSquare = kingSquare + direction;
-        std::optional<Vector2Int> candidatePin;
-        // while we are still on the board
-        while (currentSquare.x >= 0 && currentSquare.x < 8 && currentSquare.y >= 0 && currentSquare.y < 8) {
-            // if there is a piece on the current square
-            if (gameState.boardPosition[currentSquare.y][currentSquare.x]) {
-                // if the current square contains a friendly piece
-                if (gameState.boardPosition[currentSquare.y][currentSquare.x]->colour == gameState.moveColour) {
-                    // second friendly piece in a row found, no pin
-                    if (candidatePin)
-                        break;
-                    // the piece could be pinned, we need to keep walking the board in this direction to find out
-                    candidatePin = Vector2Int(currentSquare.x, currentSquare.y);
-                }
-                // the current square contains an enemy piece
-                else {
-                    if (candidatePin) {
-                        // find out if we travelled straight or diagonally to get here, the calculation will result in 1 == straight movement, 2 = diagonal movement
-                        // aka straight movement = true, diagonal movement = false
-                        const auto movedStraight = std::abs(direction.x) + std::abs(direction.y) == 1;
-
-                        // check if the enemy piece is a slider attacking in the direction of the king
-                        if (gameState.boardPosition[currentSquare.y][currentSquare.x]->type == Piece::Type::QUEEN ||
-                            (gameState.boardPosition[currentSquare.y][currentSquare.x]->type == Piece::Type::ROOK && movedStraight) ||
-                            (gameState.boardPosition[currentSquare.y][currentSquare.x]->type == Piece::Type::BISHOP && !movedStraight)) {
-                            // pin found
-                            pins[i] = PinInfo(*candidatePin, direction);
-                            break;
-                        }
-                    }
-                    // no pin because either no friendly piece between the enemy piece and the king
-                    // or the enemy piece was not a slider attacking in the direction of the king
-                    break;
-                }
-            }
-            currentSquare += direction;
-        }
+    while (pinners) {
+        const auto pinnerSquare = Bitboards::popLeastSignificantSquare(pinners);
+        const auto piecesBetween = attackTables.betweenSquares[kingSquare][pinnerSquare] & occupied;
+        if (Bitboards::popCount(piecesBetween) == 1 && (piecesBetween & gameState.colourBitboards[Traits::index]))
+            pinnedPieces |= piecesBetween;
     }
 
     // check evasion
-    CheckerInfo checkerInfo;
-
-    // pawns
-    // get forward step of friendly king
-    auto forwardStep = 1;
-    if (gameState.moveColour == Piece::Colour::WHITE)
-        forwardStep = -1;
+    const auto checkers = gameState.checkersBitboard;
+    const auto numCheckers = Bitboards::popCount(checkers);
+
+    // no check, every destination allowed
+    auto allowedDestinations = ~Bitboard{0};
+    // single check, only moves that capture the checker or block the check ray are allowed
+    if (numCheckers == 1)
+        allowedDestinations = checkers | attackTables.betweenSquares[kingSquare][Bitboards::leastSignificantSquare(checkers)];
+    // two or more checkers, only king moves that move out of check are allowed
+    else if (numCheckers > 1)
+        allowedDestinations = 0;
+
+    // pieces can never move onto a friendly piece, and kings are never capturable in chess.
+    // tactical generation only targets enemy pieces and quiet generation only targets empty squares
+    const auto captureSquares = gameState.colourBitboards[Traits::enemyIndex] & ~enemyPieces[static_cast<int>(Piece::Type::KING)];
+    Bitboard targetSquares = 0;
+    if (generationType != GameTypes::MoveGenerationType::QUIETS)
+        targetSquares |= captureSquares;
+    if (generationType != GameTypes::MoveGenerationType::TACTICAL)
+        targetSquares |= ~occupied;
+
+    // a pinned piece may only move along the line joining its king and the pinning piece
+    const auto getPinMask = [&](const int square) {
+        return pinnedPieces & Bitboards::squareBitboard(square) ? attackTables.lineThroughSquares[kingSquare][square] : ~Bitboard{0};
+    };
 
-    // check for enemy pawns on the two diagonally forward squares
-    for (auto i = -1; i < 2; i += 2) {
-        const auto candidateSquare = Vector2Int(kingSquare.x + i, kingSquare.y + forwardStep);
-        if (candidateSquare.x >= 0 && candidateSquare.x < 8 && candidateSquare.y >= 0 && candidateSquare.y < 8) {
-            if (gameState.boardPosition[candidateSquare.y][candidateSquare.x]) {
-                if (gameState.boardPosition[candidateSquare.y][candidateSquare.x]->type == Piece::Type::PAWN && gameState.boardPosition[candidateSquare.y][candidateSquare.x]->colour != gameState.moveColour) {
-                    if (++checkerInfo.numCheckers == 2)
-                        goto twoCheckersFound;
-                    checkerInfo.checkerSquare = candidateSquare;
-                }
-            }
+    // moves are appended rather than replacing the list's contents, so a caller can generate the tactical and quiet
+    // moves into the same list one after the other. when only counting, a whole set of end squares is counted with one
+    // popcount and no move is ever constructed
+    size_t moveCount = 0;
+    const auto addMove = [&](const auto&... moveArguments) {
+        if constexpr (countOnly)
+            ++moveCount;
+        else
+            moves->emplace_back(moveArguments...);
+    };
+    const auto addMoves = [&](const int startSquare, Bitboard endSquares) {
+        if constexpr (countOnly)
+            moveCount += Bitboards::popCount(endSquares);
+        else {
+            while (endSquares)
+                moves->emplace_back(startSquare, Bitboards::popLeastSignificantSquare(endSquares));
         }
-    }
-    // knights
-    for (const auto& knightVector : knightVectors) {
-        const auto& candidateSquare = kingSquare + knightVector;
-        // make sure the square being checked is on the board
-        if (candidateSquare.x < 0 || candidateSquare.x > 7 || candidateSquare.y < 0 || candidateSquare.y > 7)
-            continue;
+    };
 
-        if (gameState.boardPosition[candidateSquare.y][candidateSquare.x]) {
-            if (gameState.boardPosition[candidateSquare.y][candidateSquare.x]->type == Piece::Type::KNIGHT && gameState.boardPosition[candidateSquare.y][candidateSquare.x]->colour != gameState.moveColour) {
-                if (++checkerInfo.numCheckers == 2)
-                    goto twoCheckersFound;
-                checkerInfo.checkerSquare = candidateSquare;
+    // in double check, only king moves can be legal - skip all other pieces' generation
+    if (numCheckers < 2) {
+        // -------------------- pawns --------------------
+
+        constexpr auto forwardStep = Traits::forwardStep;
+        constexpr auto promotionRank = Traits::promotionRank;
+        // a pawn can never stand on either back rank, masking them out keeps the push squares below on the board
+        auto pawns = friendlyPieces[static_cast<int>(Piece::Type::PAWN)] & ~(Bitboards::rank0 | Bitboards::rank7);
+        while (pawns) {
+            const auto startSquare = Bitboards::popLeastSignificantSquare(pawns);
+            const auto pinMask = getPinMask(startSquare);
+
+            Bitboard pushSquares = 0;
+            // single push, then double push from the starting rank if both squares are empty
+            if (const auto singlePushSquare = startSquare + forwardStep; !(occupied & Bitboards::squareBitboard(singlePushSquare))) {
+                pushSquares |= Bitboards::squareBitboard(singlePushSquare);
+                if (Bitboards::squareBitboard(startSquare) & Traits::doublePushStartRank && !(occupied & Bitboards::squareBitboard(singlePushSquare + forwardStep)))
+                    pushSquares |= Bitboards::squareBitboard(singlePushSquare + forwardStep);
             }
-        }
-    }
-    // sliders
-    for (const auto& direction : pieceDirections) {
-        auto currentSquare = kingSquare + direction;
-        std::vector<int> checkRayBuffer;
-        while (currentSquare.x >= 0 && currentSquare.x < 8 && currentSquare.y >= 0 && currentSquare.y < 8) {
-            if (gameState.boardPosition[currentSquare.y][currentSquare.x]) {
-                if (const auto piece = *gameState.boardPosition[currentSquare.y][currentSquare.x]; piece.colour != gameState.moveColour) {
-                    // find out if we travelled straight or diagonally to get here, the calculation will result in 1 == straight movement, 2 = diagonal movement
-                    const bool movedStraight = std::abs(direction.x) + std::abs(direction.y) == 1;
-                    if (piece.type == Piece::Type::QUEEN || (piece.type == Piece::Type::ROOK && movedStraight) || (piece.type == Piece::Type::BISHOP && !movedStraight)) {
-                        if (++checkerInfo.numCheckers == 2)
-                            goto twoCheckersFound;
-                        checkerInfo.checkerSquare = currentSquare;
-                        for (const auto& squareIndex : checkRayBuffer)
-                            checkerInfo.checkRay[squareIndex] = true;
-                    }
+            // a push onto the last rank is a promotion, so it counts as a tactical move rather than a quiet one
+            Bitboard endSquares = 0;
+            if (generationType != GameTypes::MoveGenerationType::QUIETS)
+                endSquares |= (pushSquares & promotionRank) | (attackTables.pawnAttacks[Traits::index][startSquare] & captureSquares);
+            if (generationType != GameTypes::MoveGenerationType::TACTICAL)
+                endSquares |= pushSquares & ~promotionRank;
+            endSquares &= allowedDestinations & pinMask;
+            // the engine always promotes to a queen for the time being, perft expands the other three pieces itself
+            auto promotionEndSquares = endSquares & promotionRank;
+            if constexpr (countOnly)
+                moveCount += 4 * Bitboards::popCount(promotionEndSquares);
+            else {
+                while (promotionEndSquares)
+                    moves->emplace_back(startSquare, Bitboards::popLeastSignificantSquare(promotionEndSquares), Move::Flag::PROMOTION, Piece::Type::QUEEN);
+            }
+            addMoves(startSquare, endSquares & ~promotionRank);
+
+            // en passant. the pawn being taken is the checker when it has just double pushed into check, so the move is
+            // also allowed when the captured pawn's square (rather than the destination square) resolves the check
+            if (generationType != GameTypes::MoveGenerationType::QUIETS && gameState.enPassantSquare && attackTables.pawnAttacks[Traits::index][startSquare] & Bitboards::squareBitboard(toSquareIndex(*gameState.enPassantSquare))) {
+                const auto move = Move(startSquare, toSquareIndex(*gameState.enPassantSquare), Move::Flag::ENPASSANT);
+                const auto enPassantSquare = Bitboards::squareBitboard(toSquareIndex(*gameState.enPassantSquare));
+                const auto capturedPawnSquare = Bitboards::squareBitboard(toSquareIndex(*gameState.enPassantSquare) - forwardStep);
+                if ((enemyPieces[static_cast<int>(Piece::Type::PAWN)] & capturedPawnSquare) && (enPassantSquare & pinMask) && (allowedDestinations & (enPassantSquare | capturedPawnSquare))) {
+                    // EP can expose a horizontal discovered check that the pin table missed, as it takes two pieces off the
+                    // same rank at once, so the king's safety is tested against the occupancy after the move for this one case
+                    if (!wouldMoveLeaveKingInCheck(gameState, move))
+                        addMove(move);
                 }
-                // friendly piece found
-                break;
             }
-            // no piece on this square
-            checkRayBuffer.emplace_back(currentSquare.y * 8 + currentSquare.x);
-            currentSquare += direction;
         }
-    }
 
-    // label to skip unnecessary computation if two checkers are found
-    twoCheckersFound:
-
-    std::array<bool, 64> allowedDestinations{};
-    if (checkerInfo.numCheckers == 0)
-        // no check, every destination allowed
-        allowedDestinations.fill(true);
-    else if (checkerInfo.numCheckers == 1) {
-        // in case a double pushed pawn that can be taken by enpassant is the only checker
-        if (gameState.enPassantSquare) {
-            const int enemyForwardStep = gameState.moveColour == Piece::Colour::WHITE ? 1 : -1;
-            const Vector2Int enPassantPawnSquare(gameState.enPassantSquare->x,gameState.enPassantSquare->y + enemyForwardStep);
-            if (enPassantPawnSquare == checkerInfo.checkerSquare)
-                allowedDestinations[gameState.enPassantSquare->y * 8 + gameState.enPassantSquare->x] = true;
-        }
-        // single check, only moves that capture the checker or block the check ray are allowed
-        // checking piece
-        allowedDestinations[checkerInfo.checkerSquare->y * 8 + checkerInfo.checkerSquare->x] = true;
-        // checking ray
-        for (auto i = 0; i < 64; ++i) {
-            if (checkerInfo.checkRay[i])
-                allowedDestinations[i] = true;
+        // -------------------- knights --------------------
+
+        // knights cannot move if pinned
+        auto knights = friendlyPieces[static_cast<int>(Piece::Type::KNIGHT)] & ~pinnedPieces;
+        while (knights) {
+            const auto startSquare = Bitboards::popLeastSignificantSquare(knights);
+            addMoves(startSquare, attackTables.knightAttacks[startSquare] & targetSquares & allowedDestinations);
         }
-    }
-    // else two or more checkers, only king moves that move out of check are allowed, mask stays all false
 
-    std::vector<Move> moves;
-    for (auto rank = 0; rank < 8; ++rank) {
-        for (auto file = 0; file < 8; ++file) {
-            if (gameState.boardPosition[rank][file] && gameState.boardPosition[rank][file]->colour == gameState.moveColour) {
-                const auto moveStartSquare = Vector2Int(file, rank);
-
-                // in double check, only king moves can be legal - skip all other pieces' generation
-                if (checkerInfo.numCheckers >= 2 && gameState.boardPosition[rank][file]->type != Piece::Type::KING)
-                    continue;
-
-                // check whether this piece is pinned and get the pin direction if so
-                auto pinned = false;
-                Vector2Int pinDirection{};
-                for (const auto& pin : pins) {
-                    if (pin && pin->pinSquare == moveStartSquare) {
-                        pinned = true;
-                        pinDirection = pin->pinDirection;
-                        break;
-                    }
-                }
+        // -------------------- sliders --------------------
 
-                auto addSliderMovesAlongRayIfLegal = [&](const Vector2Int direction) {
-                    // use cross product of 2d vectors to ensure move direction is parallel to the pin direction
-                    if (pinned && direction.x * pinDirection.y != direction.y * pinDirection.x)
-                        return;
-                    auto currentSquare = Vector2Int(file + direction.x, rank + direction.y);
-                    while (currentSquare.x >= 0 && currentSquare.x < 8 && currentSquare.y >= 0 && currentSquare.y < 8) {
-                        const Move move(moveStartSquare, currentSquare);
-                        if (!isMoveValid(gameState, move))
-                            break;
-                        if (!allowedDestinations[currentSquare.y * 8 + currentSquare.x]) {
-                            currentSquare += direction;
-                            continue;
-                        }
-                        moves.emplace_back(move);
-                        // stop when we hit any piece (capture or friendly blocker)
-                        if (gameState.boardPosition[currentSquare.y][currentSquare.x])
-                            break;
-                        currentSquare += direction;
-                    }
-                };
-
-                // generate all possible moves for each piece, accounting for the piece being pinned if applicable
-                switch (gameState.boardPosition[rank][file]->type) {
-                case Piece::Type::PAWN:
-                    {
-                        const int forwardStep = (gameState.moveColour == Piece::Colour::WHITE) ? -1 : 1;
-
-                        auto addPawnMoveIfLegal = [&](const int dx, const int dy)
-                        {
-                            // use cross product of 2d vectors to ensure move direction is parallel to the pin direction
-                            if (pinned && dx * pinDirection.y != dy * pinDirection.x)
-                                return;
-                            const int destX = file + dx;
-                            const int destY = rank + dy;
-                            if (destX < 0 || destX > 7 || destY < 0 || destY > 7)
-                                return;
-                            const Move move(moveStartSquare, Vector2Int(destX, destY));
-                            if (!allowedDestinations[move.endSquare.y * 8 + move.endSquare.x])
-                                return;
-                            if (isMoveValid(gameState, move)) {
-                                if (gameState.enPassantSquare && move.endSquare == *gameState.enPassantSquare) {
-                                    // EP can expose a horizontal discovered check that the pin table missed,
-                                    // so fall back to a full simulation just for this one case.
-                                    GameState simulated = gameState;
-                                    movePiece(simulated, move);
-                                    if (isKingInCheck(simulated, gameState.moveColour))
-                                        // illegal, would expose king
-                                        return;
-                                }
-                                moves.emplace_back(move);
-                            }
-                        };
-
-                        // single push
-                        addPawnMoveIfLegal(0,  forwardStep);
-                        // double push
-                        addPawnMoveIfLegal(0,  2 * forwardStep);
-                        // diagonal forward-right capture
-                        addPawnMoveIfLegal(1,  forwardStep);
-                        // diagonal forward-left capture
-                        addPawnMoveIfLegal(-1, forwardStep);
-                        break;
-                    }
-                case Piece::Type::KNIGHT:
-                    // knights cannot move if pinned
-                    if (pinned)
-                        break;
-                    for (const auto& knightVector : knightVectors) {
-                        const auto move = Move(moveStartSquare, moveStartSquare + knightVector);
-                        if (move.endSquare.x < 0 || move.endSquare.x >= 8 || move.endSquare.y < 0 || move.endSquare.y >= 8)
-                            continue;
-                        if (!allowedDestinations[move.endSquare.y * 8 + move.endSquare.x])
-                            continue;
-                        if (isMoveValid(gameState, move))
-                            moves.emplace_back(move);
-                    }
-                    break;
-                case Piece::Type::BISHOP:
-                    for (auto i = 4; i < 8; ++i)
-                        addSliderMovesAlongRayIfLegal(pieceDirections[i]);
-                    break;
-                case Piece::Type::ROOK:
-                    for (auto i = 0; i < 4; ++i)
-                        addSliderMovesAlongRayIfLegal(pieceDirections[i]);
-                    break;
-                case Piece::Type::QUEEN:
-                    for (auto i = 0; i < 8; ++i)
-                        addSliderMovesAlongRayIfLegal(pieceDirections[i]);
-                    break;
-                case Piece::Type::KING:
-                    // ordinary moves
-                    for (const auto& direction : pieceDirections) {
-                        const auto move = Move(moveStartSquare, Vector2Int(file + direction.x, rank + direction.y));
-                        if (isMoveValid(gameState, move) && !isSquareUnderAttack(gameState, move.endSquare, gameState.moveColour == Piece::Colour::WHITE ? Piece::Colour::BLACK : Piece::Colour::WHITE, move.startSquare))
-                            moves.emplace_back(move);
-                    }
-                    // cannot castle if the king is in check
-                    if (checkerInfo.numCheckers > 0)
-                        break;
-                    // castling moves - try both queenside (king to c-file = 2) and kingside (king to g-file = 6).
-                    // checkForCastle handles the structural conditions (castling rights still held, rook still on its
-                    // starting square, path between king and rook empty). this block layers in the attack-safety
-                    // conditions: the king must not start in check, must not pass through an attacked square, and
-                    // must not end on an attacked square. kingSquare is passed to isSquareUnderAttack as the
-                    // ignore-square hint so sliders can find the king's path through the now-vacated start square.
-                    const auto enemyColour = gameState.moveColour == Piece::Colour::WHITE ? Piece::Colour::BLACK : Piece::Colour::WHITE;
-                    for (const int destinationFile : {2, 6}) {
-                        const auto castleMove = Move(moveStartSquare, Vector2Int(destinationFile, kingSquare.y));
-                        if (checkForCastle(gameState, castleMove) == GameTypes::CastleType::NOCASTLE)
-                            continue;
-
-                        // walk every square the king travels through, inclusive of both endpoints. for kingside
-                        // (e -> g) that's e/f/g; for queenside (e -> c) that's e/d/c. note: the b-file square on
-                        // queenside is NOT checked here - the rook crosses it but rooks may safely pass through
-                        // attacked squares while castling, only the king's path matters.
-                        const int step = destinationFile > kingSquare.x ? 1 : -1;
-                        bool pathSafe = true;
-                        for (int currentFile = kingSquare.x; ; currentFile += step) {
-                            if (isSquareUnderAttack(gameState, Vector2Int(currentFile, kingSquare.y), enemyColour, kingSquare)) {
-                                pathSafe = false;
-                                break;
-                            }
-                            if (currentFile == destinationFile)
-                                break;
-                        }
-
-                        if (pathSafe)
-                            moves.emplace_back(castleMove);
-                    }
-                    break;
-                }
-            }
+        // queens are included in both groups, so they get their orthogonal and diagonal moves from the two loops
+        auto diagonalSliders = friendlyPieces[static_cast<int>(Piece::Type::BISHOP)] | friendlyPieces[static_cast<int>(Piece::Type::QUEEN)];
+        while (diagonalSliders) {
+            const auto startSquare = Bitboards::popLeastSignificantSquare(diagonalSliders);
+            addMoves(startSquare, Bitboards::bishopAttacks(startSquare, occupied) & targetSquares & allowedDestinations & getPinMask(startSquare));
         }
+        auto orthogonalSliders = friendlyPieces[static_cast<int>(Piece::Type::ROOK)] | friendlyPieces[static_cast<int>(Piece::Type::QUEEN)];
+        while (orthogonalSliders) {
+            const auto startSquare = Bitboards::popLeastSignificantSquare(orthogonalSliders);
+            addMoves(startSquare, Bitboards::rookAttacks(startSquare, occupied) & targetSquares & allowedDestinations & getPinMask(startSquare));
+        }
+    }
+
+    // -------------------- king --------------------
+
+    if (!king)
+        return moveCount;
+
+    // every square the enemy attacks is found in one pass, so each king destination is then a single bit test.
+    // the king's own square is left out of the occupancy so sliders checking along the line of the move still see the destination as attacked
+    const auto enemyAttacks = getAttackedSquares(gameState, Traits::them, occupied & ~Bitboards::squareBitboard(kingSquare));
+    addMoves(kingSquare, attackTables.kingAttacks[kingSquare] & targetSquares & ~enemyAttacks);
+
+    // cannot castle if the king is in check
+    if (numCheckers == 0 && generationType != GameTypes::MoveGenerationType::TACTICAL && kingSquare == Traits::kingStartSquare) {
+        // each castle needs its castling right, its rook still on the starting square and nothing between the king and the rook.
+        // the king must also not pass through or land on an attacked square (it is already known not to start in check).
+        // the enemy attack map was built without the king on the board, so sliders see through its start square.
+        // note the b-file square on queenside only has to be empty - the rook crosses it but may pass through attacked squares
+        const auto rooks = friendlyPieces[static_cast<int>(Piece::Type::ROOK)];
+        const auto canCastle = [&](const int rightsIndex, const int rookStartSquare, const int kingEndSquare) {
+            const auto kingPath = attackTables.betweenSquares[kingSquare][kingEndSquare] | Bitboards::squareBitboard(kingEndSquare);
+            return gameState.castlingRights[rightsIndex] && (rooks & Bitboards::squareBitboard(rookStartSquare))
+                && !(attackTables.betweenSquares[kingSquare][rookStartSquare] & occupied) && !(kingPath & enemyAttacks);
+        };
+        // the king lands two squares towards the rook, on the c-file or the g-file
+        if (canCastle(Traits::queensideCastlingIndex, Traits::queensideRookStartSquare, Traits::kingStartSquare - 2))
+            addMove(kingSquare, Traits::kingStartSquare - 2, Move::Flag::CASTLE);
+        if (canCastle(Traits::kingsideCastlingIndex, Traits::kingsideRookStartSquare, Traits::kingStartSquare + 2))
+            addMove(kingSquare, Traits::kingStartSquare + 2, Move::Flag::CASTLE);
     }
-    if (capturesOnly) {
-        std::vector<Move> captures;
-        for (const auto& move : moves) {
-            if (gameState.boardPosition[move.endSquare.y][move.endSquare.x] || checkForEnPassantTake(gameState, move))
-                captures.push_back(move);
+    return moveCount;
+}
+
+bool Game::hasAnyLegalMove(const GameState& gameState) const {
+    // the king nearly always has a safe square to step to, and finding one only needs a few attack lookups,
+    // so try its ordinary moves before falling back to generating the whole move list
+    const auto friendlyColour = gameState.moveColour;
+    const auto enemyColour = friendlyColour == Piece::Colour::WHITE ? Piece::Colour::BLACK : Piece::Colour::WHITE;
+    if (gameState.pieceCounts[static_cast<int>(friendlyColour)][static_cast<int>(Piece::Type::KING)] != 0) {
+        const auto kingSquare = gameState.kingSquares[static_cast<int>(friendlyColour)];
+        auto kingEndSquares = Bitboards::attackTables.kingAttacks[kingSquare] & ~gameState.colourBitboards[static_cast<int>(friendlyColour)]
+                            & ~gameState.pieceBitboards[static_cast<int>(enemyColour)][static_cast<int>(Piece::Type::KING)];
+        while (kingEndSquares) {
+            if (!isSquareUnderAttack(gameState, toVector2Int(Bitboards::popLeastSignificantSquare(kingEndSquares)), enemyColour, toVector2Int(kingSquare)))
+                return true;
         }
-        return captures;
     }
-    return moves;
+
+    MoveList moves;
+    generateAllLegalMoves(gameState, moves);
+    return !moves.empty();
 }
 
 uint64_t Game::generateZobristHash(const GameState& gameState) const {
     uint64_t hash = 0;
-    for (auto rank = 0; rank < 8; ++rank) {
-        for (auto file = 0; file < 8; ++file) {
-            if (gameState.boardPosition[rank][file])
-                hash ^= zobristHashKeys.boardHash[rank * 8 + file][static_cast<int>(gameState.boardPosition[rank][file]->type)][gameState.boardPosition[rank][file]->colour == Piece::Colour::WHITE ? 0 : 1];
-        }
+    for (auto square = 0; square < 64; ++square) {
+        if (const auto piece = gameState.pieceAt(square))
+            hash ^= zobristHashKeys.boardHash[square][static_cast<int>(piece->type)][piece->colour == Piece::Colour::WHITE ? 0 : 1];
     }
 
     if (isEnPassantPlayable(gameState))
@@ -1359,22 +1235,27 @@ uint64_t Game::generateZobristHash(const GameState& gameState) const {
     return hash;
 }
 
+uint64_t Game::generatePawnZobristHash(const GameState& gameState) const {
+    uint64_t hash = 0;
+    for (auto colour = 0; colour < 2; ++colour) {
+        auto pawns = gameState.pieceBitboards[colour][static_cast<int>(Piece::Type::PAWN)];
+        while (pawns)
+            hash ^= zobristHashKeys.boardHash[Bitboards::popLeastSignificantSquare(pawns)][static_cast<int>(Piece::Type::PAWN)][colour];
+    }
+    return hash;
+}
+
 /* Is there at least one pawn directly to the side of the pawn that has just double pushed and is it/are they the opposite colour of that double pushed pawn? */
 bool Game::isEnPassantPlayable(const GameState& gameState) const {
-    if (gameState.enPassantSquare) {
-        const int enemyForwardStep = gameState.moveColour == Piece::Colour::WHITE ? 1 : -1;
-        const int captureRank = gameState.enPassantSquare->y + enemyForwardStep;
-        const int enPassantFile = gameState.enPassantSquare->x;
-
-        const auto hasFriendlyPawnAt = [&](const int file) {
-            if (file < 0 || file > 7)
-                return false;
-            const auto& square = gameState.boardPosition[captureRank][file];
-            return square && square->type == Piece::Type::PAWN && square->colour == gameState.moveColour;
-        };
+    if (gameState.moveColour == Piece::Colour::WHITE)
+        return isEnPassantPlayable<Piece::Colour::WHITE>(gameState);
+    return isEnPassantPlayable<Piece::Colour::BLACK>(gameState);
+}
 
-        if (hasFriendlyPawnAt(enPassantFile - 1) || hasFriendlyPawnAt(enPassantFile + 1))
-            return true;
-    }
-    return false;
+template<Piece::Colour Us>
+bool Game::isEnPassantPlayable(const GameState& gameState) const {
+    // a friendly pawn can take en passant exactly when an enemy pawn standing on the en passant square would attack it
+    if (!gameState.enPassantSquare)
+        return false;
+    return Bitboards::attackTables.pawnAttacks[ColourTraits<Us>::enemyIndex][toSquareIndex(*gameState.enPassantSquare)] & gameState.pieceBitboards[ColourTraits<Us>::index][static_cast<int>(Piece::Type::PAWN)];
 }
@@ -1,5 +1,6 @@
 #ifndef CHESS_GAME_H
 #define CHESS_GAME_H
+#include "bitboard.h"
 #include <array>
 #include <optional>
 #include <string>
@@ -30,6 +31,15 @@ struct Vector2Int {
     }
 };
 
+// convert between vector2 board positions and the rank * 8 + file square index used by the zobrist keys and bitboards
+constexpr int toSquareIndex(const Vector2Int square) {
+    return square.y * 8 + square.x;
+}
+
+constexpr Vector2Int toVector2Int(const int squareIndex) {
+    return {squareIndex % 8, squareIndex / 8};
+}
+
 // -------------------- castling positions --------------------
 
 inline constexpr auto whiteKingStartSquare = Vector2Int(4, 7);
@@ -48,17 +58,33 @@ namespace GameTypes {
     enum class MoveType {NONE, MOVESELF, CAPTURE, CASTLE, PROMOTEPAWN, CHECK, GAMEOVER};
     enum class GameOverType {CONTINUE, STALEMATE, TFRDRAW, FIFTYMOVEDRAW, WHITEWINBYCHECKMATE, BLACKWINBYCHECKMATE, WHITEWINBYRESIGN, BLACKWINBYRESIGN};
     enum class CastleType {NOCASTLE, WHITEQUEENSIDE, WHITEKINGSIDE, BLACKQUEENSIDE, BLACKKINGSIDE};
+    // which legal moves the generator emits. tactical moves are captures, en passant and promotions, quiets are
+    // everything else (castling included), so generating both groups gives exactly the moves ALL would
+    enum class MoveGenerationType {ALL, TACTICAL, QUIETS};
 }
 
 
 struct Piece {
-    enum class Type {KING, QUEEN, ROOK, BISHOP, KNIGHT, PAWN};
-    enum class Colour {WHITE, BLACK};
+    enum class Type : uint8_t {KING, QUEEN, ROOK, BISHOP, KNIGHT, PAWN};
+    enum class Colour : uint8_t {WHITE, BLACK};
+    // the board stores each square as a one byte piece code. 0 is an empty square, otherwise the low three bits hold
+    // the type + 1 and bit 3 holds the colour
+    using Code = uint8_t;
+    static constexpr Code emptySquare = 0;
 
     Type type;
     Colour colour;
 
-    Piece(const Type type, const Colour colour) : type(type), colour(colour) {}
+    constexpr Piece(const Type type, const Colour colour) : type(type), colour(colour) {}
+
+    [[nodiscard]] constexpr Code toCode() const {
+        return static_cast<Code>(static_cast<int>(colour) << 3 | (static_cast<int>(type) + 1));
+    }
+
+    // the code must not be emptySquare
+    [[nodiscard]] static constexpr Piece fromCode(const Code code) {
+        return {static_cast<Type>((code & 7) - 1), static_cast<Colour>(code >> 3)};
+    }
 
     bool operator==(const Piece& other) const {
         return type == other.type && colour == other.colour;
@@ -74,11 +100,66 @@ struct Piece {
     }
 };
 
+// a move packed into 16 bits so move lists, move deltas and transposition table entries stay small.
+// bits 0-5 hold the start square index, bits 6-11 the end square index, bits 12-13 the promotion piece
+// (knight, bishop, rook, queen) and bits 14-15 the flag. the default move (a8 to a8) is never legal, so it doubles as "no move".
 struct Move {
-    Vector2Int startSquare;
-    Vector2Int endSquare;
-    std::optional<Piece::Type> promotionPieceType;
-    int score = 0;
+    enum class Flag : uint8_t {NORMAL, PROMOTION, ENPASSANT, CASTLE};
+
+    uint16_t encodedMove = 0;
+
+    Move() = default;
+
+    Move(const int startSquareIndex, const int endSquareIndex, const Flag flag = Flag::NORMAL, const Piece::Type promotionPieceType = Piece::Type::KNIGHT)
+        // promotion piece types run QUEEN = 1 to KNIGHT = 4, so 4 - type packs them into 0 - 3
+        : encodedMove(static_cast<uint16_t>(startSquareIndex | endSquareIndex << 6 | (4 - static_cast<int>(promotionPieceType)) << 12 | static_cast<int>(flag) << 14)) {}
+
+    // used for moves coming from outside the generator (the gui and uci), which only know the squares and the promotion choice.
+    // Game::createMove fills in the en passant and castle flags from the board
+    Move(const Vector2Int startSquare, const Vector2Int endSquare, const std::optional<Piece::Type> promotionPieceType = std::nullopt)
+        : Move(toSquareIndex(startSquare), toSquareIndex(endSquare), promotionPieceType ? Flag::PROMOTION : Flag::NORMAL, promotionPieceType.value_or(Piece::Type::KNIGHT)) {}
+
+    [[nodiscard]] int startSquareIndex() const {return encodedMove & 0x3F;}
+    [[nodiscard]] int endSquareIndex() const {return encodedMove >> 6 & 0x3F;}
+    [[nodiscard]] Vector2Int startSquare() const {return toVector2Int(startSquareIndex());}
+    [[nodiscard]] Vector2Int endSquare() const {return toVector2Int(endSquareIndex());}
+    [[nodiscard]] Flag flag() const {return static_cast<Flag>(encodedMove >> 14);}
+    [[nodiscard]] bool isPromotion() const {return flag() == Flag::PROMOTION;}
+
+    [[nodiscard]] std::optional<Piece::Type> promotionPieceType() const {
+        if (!isPromotion())
+            return std::nullopt;
+        return static_cast<Piece::Type>(4 - (encodedMove >> 12 & 0x3));
+    }
+
+    bool operator==(const Move& other) const {
+        return encodedMove == other.encodedMove;
+    }
+};
+
+// fixed capacity move list that lives on the stack, so generating moves at a search node never touches the heap.
+// the most legal moves any reachable chess position has is 218, so 256 always fits (including expanded promotions).
+// the member names mirror std::vector so it drops into range-for loops and existing call sites unchanged
+struct MoveList {
+    static constexpr size_t capacity = 256;
+
+    std::array<Move, capacity> moves;
+    size_t count = 0;
+
+    void push_back(const Move& move) {moves[count++] = move;}
+    template <typename... Args>
+    void emplace_back(Args&&... args) {moves[count++] = Move(std::forward<Args>(args)...);}
+    void clear() {count = 0;}
+
+    [[nodiscard]] size_t size() const {return count;}
+    [[nodiscard]] bool empty() const {return count == 0;}
+    [[nodiscard]] const Move& front() const {return moves[0];}
+    Move& operator[](const size_t index) {return moves[index];}
+    const Move& operator[](const size_t index) const {return moves[index];}
+    Move* begin() {return moves.data();}
+    Move* end() {return moves.data() + count;}
+    [[nodiscard]] const Move* begin() const {return moves.data();}
+    [[nodiscard]] const Move* end() const {return moves.data() + count;}
 };
 
 // records the minimum information needed to reverse a single movePiece() call.
@@ -92,20 +173,21 @@ struct MoveDelta {
     std::optional<Vector2Int> previousEnPassantSquare;
     int previousMovesSinceEnPassant = 0;
     std::array<bool, 4> previousCastlingRights{};
+    int previousHalfMovesSinceLastActiveMove = 0;
+    Bitboard previousCheckersBitboard = 0;
     uint64_t previousZobristHash = 0;
+    uint64_t previousPawnZobristHash = 0;
 };
 
 struct GameState {
-    std::optional<Piece> selectedPiece;
-    std::optional<Vector2Int> selectedPieceStartSquare;
-    // the 2d array that all the positions of the pieces will be held in
-    // remember that while the array will hold piece positions as [row][column]/[rank][file], vector2's hold positions as (x, y) aka [column][row]/[file][rank]
-    // therefore whenever you use a vector2 to find a position in the 2d array you need to index it using [vector.y][vector.x]
-    // also remember that the origin ([0][0] for the array and (0, 0) for vectors) is the top left corner of the board for both the array and vectors
-    std::array<std::array<std::optional<Piece>, 8>, 8> boardPosition;
+    // the piece code of every square, indexed by square index (rank * 8 + file, see toSquareIndex).
+    // remember that the origin (index 0 and the vector (0, 0)) is the top left corner of the board, a8.
+    // read it through pieceAt, and only change it through placePiece/removePiece
+    std::array<Piece::Code, 64> boardPosition{};
     Piece::Colour moveColour = Piece::Colour::WHITE;
     int fullMoveCounter = 0;
     int halfMoveCounter = 0;
+    // half moves since the last capture or pawn move, used for the fifty move rule and to bound repetition checks
     int halfMovesSinceLastActiveMove = 0;
     int movesSinceEnPassant = 0;
     // {white queenside, white kingside, black queenside, black kingside
@@ -114,10 +196,68 @@ struct GameState {
     GameTypes::GameOverType gameOverType = GameTypes::GameOverType::CONTINUE;
     // zobrist hash that will contain a full board state in one 64-bit number
     uint64_t zobristHash = 0;
+    // zobrist hash of the pawns alone, using the same keys. pawn structure only changes on pawn moves, pawn captures and
+    // promotions, so the engine can cache its pawn evaluation under this key
+    uint64_t pawnZobristHash = 0;
+    // bitboards mirror boardPosition as sets of squares so the hot query functions can test whole groups of pieces at once.
+    // pieceBitboards is accessed with [piece colour][piece type] using the same indexing as the zobrist keys (0 = white, 1 = black).
+    // they must only be changed through placePiece/removePiece so they never drift out of sync with boardPosition
+    std::array<std::array<Bitboard, 6>, 2> pieceBitboards{};
+    std::array<Bitboard, 2> colourBitboards{};
+    Bitboard occupiedBitboard = 0;
+    // piece counts and king squares are kept up to date alongside the bitboards, so the evaluation and the king lookups
+    // don't have to count or search for anything. both are indexed the same way as the bitboards.
+    // a king square is only meaningful while that side's king count is 1
+    std::array<std::array<int, 6>, 2> pieceCounts{};
+    std::array<int, 2> kingSquares{};
+    // every piece count packed into one number, four bits per colour and type, so two positions with the same material have
+    // the same key. the engine looks up its material evaluation (phase, balance and known endgames) by this key
+    uint64_t materialKey = 0;
+    // the enemy pieces giving check to the side to move. worked out once per position by movePiece (and the fen loader)
+    // rather than by every check test, and restored by undoLastMove
+    Bitboard checkersBitboard = 0;
+
+    [[nodiscard]] static constexpr uint64_t materialKeyIncrement(const Piece piece) {
+        return uint64_t{1} << ((static_cast<int>(piece.colour) * 6 + static_cast<int>(piece.type)) * 4);
+    }
+
+    [[nodiscard]] std::optional<Piece> pieceAt(const int square) const {
+        if (boardPosition[square] == Piece::emptySquare)
+            return std::nullopt;
+        return Piece::fromCode(boardPosition[square]);
+    }
+
+    [[nodiscard]] std::optional<Piece> pieceAt(const Vector2Int square) const {
+        return pieceAt(toSquareIndex(square));
+    }
+
+    void placePiece(const Piece piece, const Vector2Int square) {
+        const auto squareIndex = toSquareIndex(square);
+        const auto squareBitboard = Bitboards::squareBitboard(squareIndex);
+        pieceBitboards[static_cast<int>(piece.colour)][static_cast<int>(piece.type)] |= squareBitboard;
+        colourBitboards[static_cast<int>(piece.colour)] |= squareBitboard;
+        occupiedBitboard |= squareBitboard;
+        ++pieceCounts[static_cast<int>(piece.colour)][static_cast<int>(piece.type)];
+        materialKey += materialKeyIncrement(piece);
+        if (piece.type == Piece::Type::KING)
+            kingSquares[static_cast<int>(piece.colour)] = squareIndex;
+        boardPosition[squareIndex] = piece.toCode();
+    }
+
+    // the square must contain a piece
+    void removePiece(const Vector2Int square) {
+        const auto squareIndex = toSquareIndex(square);
+        const auto piece = Piece::fromCode(boardPosition[squareIndex]);
+        const auto squareBitboard = Bitboards::squareBitboard(squareIndex);
+        pieceBitboards[static_cast<int>(piece.colour)][static_cast<int>(piece.type)] &= ~squareBitboard;
+        colourBitboards[static_cast<int>(piece.colour)] &= ~squareBitboard;
+        occupiedBitboard &= ~squareBitboard;
+        --pieceCounts[static_cast<int>(piece.colour)][static_cast<int>(piece.type)];
+        materialKey -= materialKeyIncrement(piece);
+        boardPosition[squareIndex] = Piece::emptySquare;
+    }
 
     void reset() {
-        selectedPiece = std::nullopt;
-        selectedPieceStartSquare = std::nullopt;
         boardPosition = {};
         moveColour = Piece::Colour::WHITE;
         fullMoveCounter = 0;
@@ -128,6 +268,14 @@ struct GameState {
         enPassantSquare = std::nullopt;
         gameOverType = GameTypes::GameOverType::CONTINUE;
         zobristHash = 0;
+        pawnZobristHash = 0;
+        pieceBitboards = {};
+        colourBitboards = {};
+        occupiedBitboard = 0;
+        pieceCounts = {};
+        kingSquares = {};
+        materialKey = 0;
+        checkersBitboard = 0;
     }
 
     bool operator==(const GameState& other) const {
@@ -157,42 +305,80 @@ struct ZobristHashKeys
     uint64_t turnHash = 0;
 };
 
-class Game {
-    // 0 - 3 are the orthogonals, 4 - 7 are the diagonals
-    static constexpr std::array pieceDirections = {Vector2Int(1, 0), Vector2Int(0, 1), Vector2Int(-1, 0), Vector2Int(0, -1), Vector2Int(1, 1), Vector2Int(-1, -1), Vector2Int(1, -1), Vector2Int(-1, 1)};
-    static constexpr std::array knightVectors = {Vector2Int(2, 1), Vector2Int(-2, -1), Vector2Int(2, -1), Vector2Int(-2, 1), Vector2Int(1, 2), Vector2Int(-1, -2), Vector2Int(1, -2), Vector2Int(-1, 2)};
+// the keys come from a splitmix64 generator with a fixed seed, run at compile time so nothing is generated on startup
+[[nodiscard]] constexpr ZobristHashKeys generateZobristHashKeys() {
+    uint64_t state = 42;
+    const auto nextRandom = [&state] {
+        state += 0x9E3779B97F4A7C15ULL;
+        auto value = state;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+        return value ^ (value >> 31);
+    };
+
+    ZobristHashKeys zobristHashKeys;
+    for (auto& square : zobristHashKeys.boardHash) {
+        for (auto& pieceType : square) {
+            for (auto& key : pieceType)
+                key = nextRandom();
+        }
+    }
+    for (auto& key : zobristHashKeys.enPassantFileHash)
+        key = nextRandom();
+    for (auto& key : zobristHashKeys.castlingRightsHash)
+        key = nextRandom();
+    zobristHashKeys.turnHash = nextRandom();
 
-    GameState currentGameState;
-    std::vector<GameState> currentGameStateHistory;
+    return zobristHashKeys;
+}
 
-    [[nodiscard]] static ZobristHashKeys generateZobristHashKeys();
-    inline static const ZobristHashKeys zobristHashKeys = generateZobristHashKeys();
+class Game {
+    GameState currentGameState;
+    // zobrist hashes of every position reached before the current one, oldest first. repetition checks only look at the
+    // positions since the last capture or pawn move, as no position before an irreversible move can ever occur again
+    std::vector<uint64_t> currentZobristHashHistory;
+
+    inline static constexpr ZobristHashKeys zobristHashKeys = generateZobristHashKeys();
+
+    // the legal end squares of every start square in the last position the gui asked about, keyed by that position's
+    // zobrist hash. it is filled from a single run of the move generator, so picking up pieces doesn't regenerate anything
+    struct LegalMoveCache {
+        bool valid = false;
+        uint64_t zobristHash = 0;
+        std::array<Bitboard, 64> endSquares{};
+    };
+    mutable LegalMoveCache legalMoveCache;
+
+    // specialisations for each side to move, the public versions of these look at gameState.moveColour once and dispatch to them
+    template<Piece::Colour Us> MoveDelta movePiece(GameState& gameState, const Move& move) const;
+    // when countOnly is set nothing is written to moves (which may be null) and only the number of legal moves is returned
+    template<Piece::Colour Us, bool countOnly> size_t generateLegalMoves(const GameState& gameState, MoveList* moves, GameTypes::MoveGenerationType generationType) const;
+    template<Piece::Colour Us> [[nodiscard]] bool isEnPassantPlayable(const GameState& gameState) const;
 
 public:
     // -------------------- getters --------------------
 
     [[nodiscard]] GameState& getCurrentGameState() {return currentGameState;}
     [[nodiscard]] const GameState& getCurrentGameState() const {return currentGameState; }
-    [[nodiscard]] std::vector<GameState>& getCurrentGameStateHistory() {return currentGameStateHistory;}
-    [[nodiscard]] const std::vector<GameState>& getCurrentGameStateHistory() const { return currentGameStateHistory; }
-    [[nodiscard]] std::array<std::array<std::optional<Piece>, 8>, 8> getCurrentBoardPosition() const {return currentGameState.boardPosition;}
-    [[nodiscard]] std::optional<Vector2Int> getCurrentSelectedPieceStartSquare() const {return currentGameState.selectedPieceStartSquare;}
-    [[nodiscard]] std::optional<Piece> getCurrentSelectedPiece() const {return currentGameState.selectedPiece;}
+    [[nodiscard]] std::vector<uint64_t>& getCurrentZobristHashHistory() {return currentZobristHashHistory;}
+    [[nodiscard]] const std::vector<uint64_t>& getCurrentZobristHashHistory() const { return currentZobristHashHistory; }
+    [[nodiscard]] const std::array<Piece::Code, 64>& getCurrentBoardPosition() const {return currentGameState.boardPosition;}
     [[nodiscard]] GameTypes::GameOverType getCurrentGameOverType() const {return currentGameState.gameOverType;}
     [[nodiscard]] std::vector<Vector2Int> generateLegalMovesForSquare(const GameState& gameState, Vector2Int startSquare) const;
 
     // -------------------- application functions (modify the game state) --------------------
 
     void reset();
-    bool populateGameStateFromFEN(GameState& gameState, std::vector<GameState>& gameStateHistory, const std::string& fen) const;
-    bool pickupPieceFromBoard(GameState& gameState, Vector2Int startSquare) const;
-    GameTypes::MoveType placePieceOnBoard(GameState& gameState, Vector2Int endSquare, std::vector<GameState>& gameStateHistory, const Piece* pawnPromotionChoice) const;
+    bool populateGameStateFromFEN(GameState& gameState, std::vector<uint64_t>& zobristHashHistory, const std::string& fen) const;
+    GameTypes::MoveType placePieceOnBoard(GameState& gameState, std::optional<Vector2Int> startSquare, Vector2Int endSquare, std::vector<uint64_t>& zobristHashHistory, const Piece* pawnPromotionChoice) const;
     MoveDelta movePiece(GameState& gameState, const Move& move) const;
     void undoLastMove(GameState& gameState, const MoveDelta& moveDelta) const;
     void castleRook(GameState& gameState, GameTypes::CastleType castleType) const;
 
     // -------------------- validation/helper functions (do not modify the game state) --------------------
 
+    [[nodiscard]] Move createMove(const GameState& gameState, Vector2Int startSquare, Vector2Int endSquare, std::optional<Piece::Type> promotionPieceType) const;
+    [[nodiscard]] bool canPickupPieceFromBoard(const GameState& gameState, Vector2Int startSquare) const;
     [[nodiscard]] bool isMoveValid(const GameState& gameState, const Move& move) const;
     [[nodiscard]] bool isMoveLegal(const GameState& gameState, const Move& move) const;
     [[nodiscard]] bool isMovePathClearForSliders(const GameState& gameState, const Move& move) const;
@@ -201,13 +387,21 @@ public:
     [[nodiscard]] bool isMoveValidForPawn(const GameState& gameState, const Move& move) const;
     [[nodiscard]] bool checkForPawnDoublePush(const GameState& gameState, const Move& move) const;
     [[nodiscard]] bool checkForEnPassantTake(const GameState& gameState, const Move &move) const;
+    [[nodiscard]] Bitboard getAttackersToSquare(const GameState& gameState, int square, Bitboard occupied) const;
+    [[nodiscard]] Bitboard getAttackedSquares(const GameState& gameState, Piece::Colour attackingColour, Bitboard occupied) const;
+    [[nodiscard]] Bitboard calculateCheckers(const GameState& gameState) const;
     [[nodiscard]] bool isSquareUnderAttack(const GameState& gameState, Vector2Int square, Piece::Colour enemyColour, std::optional<Vector2Int> ignoredSquare) const;
-    [[nodiscard]] bool isSquareUnderAttackByPawn(const GameState& gameState, Vector2Int square, Piece::Colour enemyColour) const;
     [[nodiscard]] bool isKingInCheck(const GameState& gameState, Piece::Colour kingColour) const;
+    [[nodiscard]] int countRepetitions(const GameState& gameState, const std::vector<uint64_t>& zobristHashHistory) const;
+    [[nodiscard]] bool wouldMoveLeaveKingInCheck(const GameState& gameState, const Move& move) const;
     [[nodiscard]] bool checkForPawnPromotionOnLastMove(const GameState& gameState) const;
     [[nodiscard]] bool checkForPawnPromotionOnNextMove(const GameState& gameState, const Move& move) const;
-    [[nodiscard]] std::vector<Move> generateAllLegalMoves(const GameState& gameState, bool capturesOnly = false) const;
+    void generateAllLegalMoves(const GameState& gameState, MoveList& moves, GameTypes::MoveGenerationType generationType = GameTypes::MoveGenerationType::ALL) const;
+    // the number of legal moves without building any of them, each promotion counts as four moves (one per piece) like perft does
+    [[nodiscard]] size_t countLegalMoves(const GameState& gameState) const;
+    [[nodiscard]] bool hasAnyLegalMove(const GameState& gameState) const;
     [[nodiscard]] uint64_t generateZobristHash(const GameState& gameState) const;
+    [[nodiscard]] uint64_t generatePawnZobristHash(const GameState& gameState) const;
     [[nodiscard]] bool isEnPassantPlayable(const GameState& gameState) const;
 };
 
@@ -54,7 +54,7 @@ void processUserInput(const std::optional<sf::Event> &event) {
         if (mouseButtonPressed->button == sf::Mouse::Button::Left)
         {
             mousePosition = {mouseButtonPressed->position.x, mouseButtonPressed->position.y};
-            if (const Vector2Int startSquare = boardView.getSquare(mousePosition.x, mousePosition.y); game.pickupPieceFromBoard(game.getCurrentGameState(), startSquare))
+            if (const Vector2Int startSquare = boardView.getSquare(mousePosition.x, mousePosition.y); game.canPickupPieceFromBoard(game.getCurrentGameState(), startSquare))
                 boardView.pickupPieceFromBoard(startSquare, game.generateLegalMovesForSquare(game.getCurrentGameState(), startSquare));
         }
     }
@@ -87,8 +87,8 @@ void processUserInput(const std::optional<sf::Event> &event) {
 
             // check ahead of making the move if the move will promote a pawn, need to get the player choice of pawn promotion before the move is made
             if (!waitingForPawnPromotionChoice && !pawnPromotionPiece) {
-                if (game.getCurrentGameState().selectedPieceStartSquare) {
-                    if (game.checkForPawnPromotionOnNextMove(game.getCurrentGameState(), Move(game.getCurrentGameState().selectedPieceStartSquare.value(), endSquare))) {
+                if (const auto selectedPieceStartSquare = boardView.getSelectedPieceStartSquare()) {
+                    if (game.checkForPawnPromotionOnNextMove(game.getCurrentGameState(), Move(selectedPieceStartSquare.value(), endSquare))) {
                         pawnPromotionSquare = endSquare;
                         waitingForPawnPromotionChoice = true;
                     }
@@ -102,12 +102,12 @@ void processUserInput(const std::optional<sf::Event> &event) {
             GameTypes::MoveType moveType;
             if (pawnPromotionPiece) {
                 // promoting a pawn requires passing in the pawnPromotionSquare as the endSquare because the endSquare is based on mouse position and that won't be accurate if the player selected a promotion piece other than the queen
-                moveType = game.placePieceOnBoard(game.getCurrentGameState(), pawnPromotionSquare, game.getCurrentGameStateHistory(), pawnPromotionPiece);
+                moveType = game.placePieceOnBoard(game.getCurrentGameState(), boardView.getSelectedPieceStartSquare(), pawnPromotionSquare, game.getCurrentZobristHashHistory(), pawnPromotionPiece);
                 boardView.placePieceOnBoard(moveType != GameTypes::MoveType::NONE, pawnPromotionSquare);
             }
             else {
                 // standard move (not promoting a pawn)
-                moveType = game.placePieceOnBoard(game.getCurrentGameState(), endSquare, game.getCurrentGameStateHistory(), nullptr);
+                moveType = game.placePieceOnBoard(game.getCurrentGameState(), boardView.getSelectedPieceStartSquare(), endSquare, game.getCurrentZobristHashHistory(), nullptr);
                 boardView.placePieceOnBoard(moveType != GameTypes::MoveType::NONE, endSquare);
             }
             delete pawnPromotionPiece;
@@ -126,7 +126,7 @@ void processEngineMove() {
         return;
 
     if (!engineThinking) {
-        if (const auto legalMoves = game.generateAllLegalMoves(game.getCurrentGameState()); legalMoves.empty()) {
+        if (!game.hasAnyLegalMove(game.getCurrentGameState())) {
             // the game is either drawn or lost for the engine
             std::cout << "no legal moves left for engine" << std::endl;
             return;
@@ -161,13 +161,12 @@ void processEngineMove() {
             }
             engineThinking = false;
 
-            game.pickupPieceFromBoard(game.getCurrentGameState(), move->startSquare);
-            boardView.pickupPieceFromBoard(move->startSquare, game.generateLegalMovesForSquare(game.getCurrentGameState(), move->startSquare));
+            boardView.pickupPieceFromBoard(move->startSquare(), game.generateLegalMovesForSquare(game.getCurrentGameState(), move->startSquare()));
 
             // for now, engine will always promote a pawn to a queen
             const auto piece = Piece(Piece::Type::QUEEN, game.getCurrentGameState().moveColour);
-            const auto moveType = game.placePieceOnBoard(game.getCurrentGameState(), move->endSquare, game.getCurrentGameStateHistory(), &piece);
-            boardView.placePieceOnBoard(moveType != GameTypes::MoveType::NONE, move->endSquare);
+            const auto moveType = game.placePieceOnBoard(game.getCurrentGameState(), move->startSquare(), move->endSquare(), game.getCurrentZobristHashHistory(), &piece);
+            boardView.placePieceOnBoard(moveType != GameTypes::MoveType::NONE, move->endSquare());
 
             audio.playSoundOnMove(moveType);
             engineTurn = false;
@@ -181,12 +180,12 @@ void drawWindow() {
     // -------------------------- always drawn -----------------------
 
     boardView.drawBoard(window);
-    boardView.drawPieces(window, game.getCurrentBoardPosition(), game.getCurrentSelectedPieceStartSquare());
+    boardView.drawPieces(window, game.getCurrentBoardPosition(), boardView.getSelectedPieceStartSquare());
 
     // ------------------------- conditionally drawn
 
-    if (game.getCurrentSelectedPiece() && !waitingForPawnPromotionChoice)
-        boardView.drawSelectedPiece(window, game.getCurrentSelectedPiece().value(), mousePosition.x, mousePosition.y);
+    if (const auto selectedPieceStartSquare = boardView.getSelectedPieceStartSquare(); selectedPieceStartSquare && !waitingForPawnPromotionChoice)
+        boardView.drawSelectedPiece(window, game.getCurrentGameState().pieceAt(*selectedPieceStartSquare).value(), mousePosition.x, mousePosition.y);
     if (waitingForPawnPromotionChoice) {
         int pawnPromotionOverlayY;
         // account for the side of the board that the pawn promotion menu should be displayed on
@@ -240,7 +239,7 @@ int main() {
     gameOverText.setPosition({squareSize * 2, squareSize * 3});
 
     // standard chess starting position fen string
-    game.populateGameStateFromFEN(game.getCurrentGameState(), game.getCurrentGameStateHistory(), startFen);
+    game.populateGameStateFromFEN(game.getCurrentGameState(), game.getCurrentZobristHashHistory(), startFen);
 
     // testing pawn promotion fen string
     // game.populateGameStateFromFEN("8/PPPPPPPP/8/8/8/8/pppppppp/8 w - - 0 0");
@@ -42,26 +42,26 @@ Move convertUCIMoveToGameStateMove(const std::string &uciMove) {
     // failsafe to prevent out of bounds errors, but this function should only ever be called right after checking with validateUCIMove anyway
     if (!validateUCIMove(uciMove)) {
         std::cerr << "Warning! Attempt to convert UCI move to GameState move failed as UCI move failed validation." << std::endl;
-        return Move({0, 0}, {0, 0});
+        return {};
     }
-    auto move = Move(Vector2Int(uciMove[0] - 'a', 7 - (uciMove[1] - '1')), Vector2Int(uciMove[2] - 'a', 7 - (uciMove[3] - '1')));
+    std::optional<Piece::Type> promotionPieceType;
     if (uciMove.length() == 5) {
         switch (uciMove[4]) {
             case 'q':
-                move.promotionPieceType = Piece::Type::QUEEN;
+                promotionPieceType = Piece::Type::QUEEN;
                 break;
             case 'r':
-                move.promotionPieceType = Piece::Type::ROOK;
+                promotionPieceType = Piece::Type::ROOK;
                 break;
             case 'b':
-                move.promotionPieceType = Piece::Type::BISHOP;
+                promotionPieceType = Piece::Type::BISHOP;
                 break;
             case 'n':
-                move.promotionPieceType = Piece::Type::KNIGHT;
+                promotionPieceType = Piece::Type::KNIGHT;
                 break;
         }
     }
-    return move;
+    return {Vector2Int(uciMove[0] - 'a', 7 - (uciMove[1] - '1')), Vector2Int(uciMove[2] - 'a', 7 - (uciMove[3] - '1')), promotionPieceType};
 }
 
 bool stringToInt(const std::string &string, int &value) {
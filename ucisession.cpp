@@ -1,9 +1,13 @@
 #include "ucisession.h"
 
 #include <algorithm>
+#include <cctype>
 #include <charconv>
+#include <chrono>
 
 UCISession::UCISession() {
+    // until a position command arrives the session is at the standard starting position, so go is always well defined
+    game.populateGameStateFromFEN(game.getCurrentGameState(), game.getCurrentZobristHashHistory(), PositionCommand().fen);
     completionThread = std::jthread([this](const std::stop_token& stopToken) {
         monitorSearchCompletion(stopToken);
     });
@@ -31,6 +35,9 @@ UCISession::~UCISession() {
 void UCISession::uci() const {
     std::cout << "id name " << uciSettings.name << std::endl;
     std::cout << "id author " << uciSettings.author << std::endl;
+    std::cout << "option name Hash type spin default 16 min 1 max 4096" << std::endl;
+    std::cout << "option name Threads type spin default 1 min 1 max 256" << std::endl;
+    std::cout << "option name PerftHash type spin default 16 min 0 max 4096" << std::endl;
     std::cout << "uciok" << std::endl;
 }
 
@@ -45,7 +52,45 @@ void UCISession::isReady() const {
     std::cout << "readyok" << std::endl;
 }
 
-bool UCISession::setOption(const SetOptionCommand& setOptionCommand) const {
+bool UCISession::setOption(const SetOptionCommand& setOptionCommand) {
+    // option names are case insensitive
+    auto name = setOptionCommand.name;
+    std::ranges::transform(name, name.begin(), [](const unsigned char character) { return std::tolower(character); });
+
+    // every option is a whole number, and changing either has to wait until the engine isn't using them
+    size_t value = 0;
+    const auto& valueString = setOptionCommand.value;
+    const auto [end, error] = std::from_chars(valueString.data(), valueString.data() + valueString.size(), value);
+    if (error != std::errc() || end != valueString.data() + valueString.size())
+        return false;
+
+    // size of the transposition table in megabytes
+    if (name == "hash") {
+        if (value < 1 || value > 4096)
+            return false;
+        requestEngineStop();
+        waitForSearchToBecomeIdle();
+        engine.setHashSize(value);
+        return true;
+    }
+    // number of threads the search runs on
+    if (name == "threads") {
+        if (value < 1 || value > 256)
+            return false;
+        requestEngineStop();
+        waitForSearchToBecomeIdle();
+        engine.setThreadCount(value);
+        return true;
+    }
+    // size of the perft hash table in megabytes, 0 turns it off so counts can be checked without it
+    if (name == "perfthash") {
+        if (value > 4096)
+            return false;
+        requestEngineStop();
+        waitForSearchToBecomeIdle();
+        engine.setPerftHashSize(value);
+        return true;
+    }
     return false;
 }
 
@@ -54,6 +99,7 @@ void UCISession::uciNewGame() {
     waitForSearchToBecomeIdle();
     engine.reset();
     game.reset();
+    game.populateGameStateFromFEN(game.getCurrentGameState(), game.getCurrentZobristHashHistory(), PositionCommand().fen);
 }
 
 bool UCISession::position(const PositionCommand& positionCommand) {
@@ -62,14 +108,16 @@ bool UCISession::position(const PositionCommand& positionCommand) {
 
     // check for position and move validity on a fresh game before changing the actual game
     Game updatedGame;
-    if (!updatedGame.populateGameStateFromFEN(updatedGame.getCurrentGameState(), updatedGame.getCurrentGameStateHistory(), positionCommand.fen))
+    if (!updatedGame.populateGameStateFromFEN(updatedGame.getCurrentGameState(), updatedGame.getCurrentZobristHashHistory(), positionCommand.fen))
         return false;
-    for (const auto& move : positionCommand.moves) {
-        if (!updatedGame.checkIsMoveLegal(updatedGame.getCurrentGameState(), move))
+    for (const auto& uciMove : positionCommand.moves) {
+        // uci moves only carry squares and the promotion choice, the castle and en passant flags come from the board
+        const auto move = updatedGame.createMove(updatedGame.getCurrentGameState(), uciMove.startSquare(), uciMove.endSquare(), uciMove.promotionPieceType());
+        if (!updatedGame.isMoveLegal(updatedGame.getCurrentGameState(), move))
             return false;
-        // movePiece no longer manages history; push the pre-move snapshot here so the engine can
-        // still see the full game history for any future history-dependent logic.
-        updatedGame.getCurrentGameStateHistory().emplace_back(updatedGame.getCurrentGameState());
+        // movePiece doesn't manage history; push the pre-move hash here so the engine's search
+        // can detect repetitions of positions played earlier in the game.
+        updatedGame.getCurrentZobristHashHistory().emplace_back(updatedGame.getCurrentGameState().zobristHash);
         updatedGame.movePiece(updatedGame.getCurrentGameState(), move);
     }
 
@@ -84,6 +132,7 @@ void UCISession::go(const GoCommand& goCommand) {
 
     if (goCommand.perft) {
         // autoperft sends "go perft <depth>" and expects divide-style output followed by a final node count line.
+        const auto startTime = std::chrono::steady_clock::now();
         std::uint64_t totalNodes = 0;
         // ask the engine for the subtree size below each root move so we can stream standard divide output.
         for (const auto& moveNodePair : engine.generatePerftDivide(game, *goCommand.perft)) {
@@ -94,6 +143,9 @@ void UCISession::go(const GoCommand& goCommand) {
             totalNodes += nodes;
         }
         std::cout << "Nodes searched: " << totalNodes << std::endl;
+        // the speed is reported after the total, as a standard info line, so the divide output itself is unchanged
+        const auto elapsedMilliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+        std::cout << "info nodes " << totalNodes << " time " << elapsedMilliseconds << " nps " << totalNodes * 1000 / std::max<std::uint64_t>(elapsedMilliseconds, 1) << std::endl;
         return;
     }
 
@@ -122,13 +174,13 @@ void UCISession::stop() {
 
 std::string UCISession::convertGameStateMoveToUCIMove(const Move& move) const {
     std::string uciMove;
-    uciMove += static_cast<char>('a' + move.startSquare.x);
-    uciMove += static_cast<char>('1' + (7 - move.startSquare.y));
-    uciMove += static_cast<char>('a' + move.endSquare.x);
-    uciMove += static_cast<char>('1' + (7 - move.endSquare.y));
+    uciMove += static_cast<char>('a' + move.startSquare().x);
+    uciMove += static_cast<char>('1' + (7 - move.startSquare().y));
+    uciMove += static_cast<char>('a' + move.endSquare().x);
+    uciMove += static_cast<char>('1' + (7 - move.endSquare().y));
 
-    if (move.promotionPieceType) {
-        switch (*move.promotionPieceType) {
+    if (const auto promotionPieceType = move.promotionPieceType()) {
+        switch (*promotionPieceType) {
             case Piece::Type::QUEEN:
                 uciMove += 'q';
                 break;
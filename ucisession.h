@@ -42,7 +42,7 @@ public:
     void uci() const;
     void debug(bool debugCommand);
     void isReady() const;
-    [[nodiscard]] bool setOption(const SetOptionCommand& setOptionCommand) const;
+    [[nodiscard]] bool setOption(const SetOptionCommand& setOptionCommand);
     void uciNewGame();
     bool position(const PositionCommand& positionCommand);
     void go(const GoCommand& goCommand);